@@ -1,26 +1,937 @@
 #include "big_integer.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
-#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <new>
 #include <ostream>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
-big_integer::big_integer() noexcept : data(), isNegative(false) {}
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <cpuid.h>
+#endif
+
+namespace {
+// Operands shorter than this many limbs are multiplied by the schoolbook method
+constexpr size_t KARATSUBA_THRESHOLD = 40;
+// Balanced operands at least this long are split into three parts instead of two
+constexpr size_t TOOM3_THRESHOLD = 300;
+// Operands at least this long are multiplied by number-theoretic transforms
+constexpr size_t NTT_THRESHOLD = 16000;
+
+size_t trimmedSize(const uint64_t* a, size_t size) {
+  while (size != 0 && a[size - 1] == 0) {
+    --size;
+  }
+  return size;
+}
 
-big_integer::big_integer(const big_integer& other) noexcept = default;
+// Limbs are 64-bit. Their products, sums and quotients widen through unsigned __int128 where the compiler has it and
+// are put together from 32-bit halves elsewhere.
+#ifdef __SIZEOF_INT128__
+__extension__ typedef unsigned __int128 wide_t; // __extension__ keeps -Wpedantic quiet
+#endif
+
+// Returns the low limb of a * b, the high one goes to high
+uint64_t mulWide(uint64_t a, uint64_t b, uint64_t& high) {
+#ifdef __SIZEOF_INT128__
+  wide_t product = static_cast<wide_t>(a) * b;
+  high = static_cast<uint64_t>(product >> 64);
+  return static_cast<uint64_t>(product);
+#else
+  constexpr uint64_t mask = std::numeric_limits<uint32_t>::max();
+  uint64_t lowLow = (a & mask) * (b & mask);
+  uint64_t lowHigh = (a & mask) * (b >> 32);
+  uint64_t highLow = (a >> 32) * (b & mask);
+  uint64_t middle = (lowLow >> 32) + (lowHigh & mask) + (highLow & mask);
+  high = (a >> 32) * (b >> 32) + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+  return middle << 32 | (lowLow & mask);
+#endif
+}
+
+// Returns a + b + carry, the carry out goes to carry; carries are 0 or 1
+uint64_t addCarry(uint64_t a, uint64_t b, uint64_t& carry) {
+#ifdef __SIZEOF_INT128__
+  wide_t sum = static_cast<wide_t>(a) + b + carry;
+  carry = static_cast<uint64_t>(sum >> 64);
+  return static_cast<uint64_t>(sum);
+#else
+  uint64_t sum = a + b;
+  uint64_t result = sum + carry;
+  carry = (sum < a ? 1 : 0) + (result < sum ? 1 : 0);
+  return result;
+#endif
+}
+
+// Returns a - b - borrow, the borrow out goes to borrow; borrows are 0 or 1
+uint64_t subBorrow(uint64_t a, uint64_t b, uint64_t& borrow) {
+#ifdef __SIZEOF_INT128__
+  wide_t diff = static_cast<wide_t>(a) - b - borrow;
+  borrow = static_cast<uint64_t>(diff >> 64) & 1;
+  return static_cast<uint64_t>(diff);
+#else
+  uint64_t diff = a - b;
+  uint64_t result = diff - borrow;
+  borrow = (a < b ? 1 : 0) + (diff < borrow ? 1 : 0);
+  return result;
+#endif
+}
+
+// Returns (high * 2^64 + low) / d for high < d, the remainder goes to rem
+uint64_t divWide(uint64_t high, uint64_t low, uint64_t d, uint64_t& rem) {
+  assert(high < d);
+#ifdef __SIZEOF_INT128__
+  uint64_t quotient = static_cast<uint64_t>((static_cast<wide_t>(high) << 64 | low) / d);
+  rem = low - quotient * d;
+  return quotient;
+#else
+  // long division by 32-bit digits with the divisor normalised (divlu of Hacker's Delight)
+  constexpr uint64_t mask = std::numeric_limits<uint32_t>::max();
+  int bits = std::countl_zero(d);
+  d <<= bits;
+  high = high << bits | low >> 1 >> (63 - bits);
+  low <<= bits;
+  uint64_t dHigh = d >> 32, dLow = d & mask;
+  // the digit of (numerator * 2^32 + next) / d for numerator < d, estimated by the top digit of d
+  auto digit = [dHigh, dLow](uint64_t numerator, uint64_t next) {
+    uint64_t q = numerator / dHigh, r = numerator % dHigh;
+    while (q > mask || q * dLow > (r << 32 | next)) {
+      --q;
+      r += dHigh;
+      if (r > mask) {
+        break;
+      }
+    }
+    return q;
+  };
+  uint64_t q1 = digit(high, low >> 32);
+  uint64_t middle = (high << 32 | low >> 32) - q1 * d;
+  uint64_t q0 = digit(middle, low & mask);
+  rem = ((middle << 32 | (low & mask)) - q0 * d) >> bits;
+  return q1 << 32 | q0;
+#endif
+}
+
+// a[0, size) += b[0, bSize), bSize <= size, returns the carry out of a
+uint64_t addTo(uint64_t* a, size_t size, const uint64_t* b, size_t bSize) {
+  uint64_t carry = 0;
+  size_t index = 0;
+  for (; index != bSize; ++index) {
+    a[index] = addCarry(a[index], b[index], carry);
+  }
+  for (; carry != 0 && index != size; ++index) {
+    carry = ++a[index] == 0 ? 1 : 0;
+  }
+  return carry;
+}
+
+// a[0, size) -= b[0, bSize), bSize <= size, returns the borrow out of a
+uint64_t subFrom(uint64_t* a, size_t size, const uint64_t* b, size_t bSize) {
+  uint64_t borrow = 0;
+  size_t index = 0;
+  for (; index != bSize; ++index) {
+    a[index] = subBorrow(a[index], b[index], borrow);
+  }
+  for (; borrow != 0 && index != size; ++index) {
+    borrow = a[index] == 0 ? 1 : 0;
+    --a[index];
+  }
+  return borrow;
+}
+
+// a[0, size) = b[0, size) - a[0, size) for b >= a
+void subFromReversed(uint64_t* a, const uint64_t* b, size_t size) {
+  uint64_t borrow = 0;
+  for (size_t index = 0; index != size; ++index) {
+    a[index] = subBorrow(b[index], a[index], borrow);
+  }
+  assert(borrow == 0);
+}
+
+// a[0, aSize) -= b[0, aSize) * y, returns what is still to be subtracted from a[aSize]
+uint64_t subMulRow(uint64_t* a, const uint64_t* b, size_t aSize, uint64_t y) {
+  uint64_t carry = 0;
+  for (size_t index = 0; index != aSize; ++index) {
+    uint64_t high;
+    uint64_t low = mulWide(b[index], y, high) + carry;
+    high += low < carry ? 1 : 0;
+    carry = high + (a[index] < low ? 1 : 0);
+    a[index] -= low;
+  }
+  return carry;
+}
+
+// res[0, aSize) += a[0, aSize) * y, returns the carry into res[aSize]
+uint64_t addMulRow(uint64_t* res, const uint64_t* a, size_t aSize, uint64_t y) {
+  uint64_t carry = 0;
+  for (size_t index = 0; index != aSize; ++index) {
+    uint64_t high;
+    uint64_t low = mulWide(a[index], y, high) + carry;
+    high += low < carry ? 1 : 0;
+    res[index] += low;
+    carry = high + (res[index] < low ? 1 : 0);
+  }
+  return carry;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// addMulRow on two carry chains of MULX, ADCX and ADOX (BMI2 and ADX): one adds the high half of every product to
+// the low half of the next, the other adds the low halves to res
+uint64_t addMulRowAdx(uint64_t* res, const uint64_t* a, size_t aSize, uint64_t y) {
+  uint64_t carry = 0;
+  // the loop takes two limbs at a time
+  if (aSize % 2 != 0) {
+    carry = addMulRow(res, a, 1, y);
+    ++res;
+    ++a;
+    --aSize;
+  }
+  if (aSize == 0) {
+    return carry;
+  }
+  uint64_t low, high, nextLow;
+  // the index runs from -aSize up to zero in rcx, so jrcxz ends the loop without touching the flags
+  int64_t index = -static_cast<int64_t>(aSize);
+  asm("xor %[low], %[low]\n\t"
+      "1:\n\t"
+      "mulx (%[a], %[index], 8), %[low], %[high]\n\t"
+      "adcx %[carry], %[low]\n\t"
+      "adox (%[res], %[index], 8), %[low]\n\t"
+      "mov %[low], (%[res], %[index], 8)\n\t"
+      "mulx 8(%[a], %[index], 8), %[nextLow], %[carry]\n\t"
+      "adcx %[high], %[nextLow]\n\t"
+      "adox 8(%[res], %[index], 8), %[nextLow]\n\t"
+      "mov %[nextLow], 8(%[res], %[index], 8)\n\t"
+      "lea 2(%[index]), %[index]\n\t"
+      "jrcxz 2f\n\t"
+      "jmp 1b\n"
+      "2:\n\t"
+      "mov $0, %[low]\n\t"
+      "adcx %[low], %[carry]\n\t"
+      "adox %[low], %[carry]"
+      : [carry] "+&r"(carry), [index] "+&c"(index), [low] "=&r"(low), [high] "=&r"(high),
+        [nextLow] "=&r"(nextLow)
+      : [a] "r"(a + aSize), [res] "r"(res + aSize), "d"(y)
+      : "cc", "memory");
+  return carry;
+}
+#endif
+
+using mulRowKernel = uint64_t (*)(uint64_t*, const uint64_t*, size_t, uint64_t);
+
+// The row kernel of this CPU, chosen on the first call
+mulRowKernel addMulRowKernel() {
+  static const mulRowKernel kernel = [] {
+#if defined(__x86_64__) && defined(__GNUC__)
+    // BMI2 and ADX are bits 8 and 19 of ebx in leaf 7
+    unsigned eax, ebx, ecx, edx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) != 0 && (ebx >> 8 & 1) != 0 && (ebx >> 19 & 1) != 0) {
+      return &addMulRowAdx;
+    }
+#endif
+    return &addMulRow;
+  }();
+  return kernel;
+}
+
+// a[0, size) = op(a ^ maskA, b ^ maskB) ^ maskRes limb by limb, where b[0, bSize) is padded with zeros up to size.
+// The loops carry no state from limb to limb, so the compiler turns them into vector instructions.
+template <typename Op>
+void bitwiseLimbs(uint64_t* a, size_t size, const uint64_t* b, size_t bSize, uint64_t maskA, uint64_t maskB,
+                  uint64_t maskRes, Op op) {
+  for (size_t index = 0; index != bSize; ++index) {
+    a[index] = op(a[index] ^ maskA, b[index] ^ maskB) ^ maskRes;
+  }
+  for (size_t index = bSize; index != size; ++index) {
+    a[index] = op(a[index] ^ maskA, maskB) ^ maskRes;
+  }
+}
+
+// Sum of a[0, aSize) and b[0, bSize), aSize >= bSize, with one more limb for the carry
+std::vector<uint64_t> sum(const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  std::vector<uint64_t> result(a, a + aSize);
+  result.push_back(addTo(result.data(), aSize, b, bSize));
+  return result;
+}
+
+void mulLimbs(uint64_t* res, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize);
+
+void mulSchoolbook(uint64_t* res, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  // a row of a is added for every limb of b
+  mulRowKernel addMulRowOfCpu = addMulRowKernel();
+  std::fill(res, res + aSize, 0);
+  for (size_t index = 0; index != bSize; ++index) {
+    res[index + aSize] = addMulRowOfCpu(res + index, a, aSize, b[index]);
+  }
+}
+
+// Product of possibly zero-padded limb vectors, so the recursion gets the trimmed sizes
+std::vector<uint64_t> mulVectors(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+  size_t aSize = trimmedSize(a.data(), a.size()), bSize = trimmedSize(b.data(), b.size());
+  std::vector<uint64_t> result(aSize + bSize);
+  mulLimbs(result.data(), a.data(), aSize, b.data(), bSize);
+  return result;
+}
+
+// a = a1 * B^m + a0, b = b1 * B^m + b0 with B = 2^64 and m = ceil(aSize / 2) < bSize <= aSize:
+// a * b = a1 * b1 * B^2m + ((a0 + a1) * (b0 + b1) - a0 * b0 - a1 * b1) * B^m + a0 * b0
+void mulKaratsuba(uint64_t* res, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  size_t m = (aSize + 1) / 2, size = aSize + bSize;
+  mulLimbs(res, a, m, b, m);
+  mulLimbs(res + 2 * m, a + m, aSize - m, b + m, bSize - m);
+  std::vector<uint64_t> middle = mulVectors(sum(a, m, a + m, aSize - m), sum(b, m, b + m, bSize - m));
+  subFrom(middle.data(), middle.size(), res, trimmedSize(res, 2 * m));
+  subFrom(middle.data(), middle.size(), res + 2 * m, trimmedSize(res + 2 * m, size - 2 * m));
+  addTo(res + m, size - m, middle.data(), trimmedSize(middle.data(), middle.size()));
+}
+
+// Signed values of the Toom-3 interpolation, which may go below zero
+struct signedLimbs {
+  std::vector<uint64_t> abs;
+  bool isNegative = false;
+};
+
+void trim(std::vector<uint64_t>& a) {
+  a.resize(trimmedSize(a.data(), a.size()));
+}
+
+bool absLess(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b) {
+  size_t aSize = trimmedSize(a.data(), a.size()), bSize = trimmedSize(b.data(), b.size());
+  if (aSize != bSize) {
+    return aSize < bSize;
+  }
+  return std::lexicographical_compare(a.rend() - aSize, a.rend(), b.rend() - bSize, b.rend());
+}
+
+// a += b, or a -= b with `subtract`
+void addSigned(signedLimbs& a, const signedLimbs& b, bool subtract = false) {
+  bool bNegative = b.isNegative ^ subtract;
+  if (a.isNegative == bNegative) {
+    if (a.abs.size() < b.abs.size()) {
+      a.abs.resize(b.abs.size());
+    }
+    a.abs.push_back(addTo(a.abs.data(), a.abs.size(), b.abs.data(), b.abs.size()));
+  } else if (absLess(a.abs, b.abs)) {
+    std::vector<uint64_t> diff(b.abs);
+    subFrom(diff.data(), diff.size(), a.abs.data(), trimmedSize(a.abs.data(), a.abs.size()));
+    a.abs.swap(diff);
+    a.isNegative = bNegative;
+  } else {
+    subFrom(a.abs.data(), a.abs.size(), b.abs.data(), trimmedSize(b.abs.data(), b.abs.size()));
+  }
+  trim(a.abs);
+  if (a.abs.empty()) {
+    a.isNegative = false;
+  }
+}
+
+// Exact division by a small scalar
+void divExact(signedLimbs& a, uint64_t scalar) {
+  uint64_t rest = 0;
+  for (size_t index = a.abs.size(); index != 0; --index) {
+    a.abs[index - 1] = divWide(rest, a.abs[index - 1], scalar, rest);
+  }
+  assert(rest == 0);
+  trim(a.abs);
+}
+
+void shiftLeft1(signedLimbs& a) {
+  a.abs.push_back(0);
+  for (size_t index = a.abs.size() - 1; index != 0; --index) {
+    a.abs[index] = a.abs[index] << 1 | a.abs[index - 1] >> 63;
+  }
+  a.abs[0] <<= 1;
+  trim(a.abs);
+}
+
+signedLimbs mulSigned(const signedLimbs& a, const signedLimbs& b) {
+  signedLimbs result{mulVectors(a.abs, b.abs), a.isNegative != b.isNegative};
+  trim(result.abs);
+  if (result.abs.empty()) {
+    result.isNegative = false;
+  }
+  return result;
+}
+
+// a = a2 * B^2k + a1 * B^k + a0 and the same for b, with k = ceil(aSize / 3) and 2k < bSize <= aSize. The product
+// polynomial is evaluated at 0, 1, -1, -2 and infinity and interpolated by Bodrato's sequence.
+void mulToom3(uint64_t* res, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  size_t k = (aSize + 2) / 3, size = aSize + bSize;
+  auto part = [k](const uint64_t* x, size_t xSize, size_t index) {
+    const uint64_t* begin = x + index * k;
+    return signedLimbs{std::vector<uint64_t>(begin, begin + std::min(k, xSize - index * k)), false};
+  };
+  // values at 1, -1 and -2 of x2 * t^2 + x1 * t + x0
+  auto evaluate = [](const signedLimbs& x0, const signedLimbs& x1, const signedLimbs& x2) {
+    signedLimbs even = x0;
+    addSigned(even, x2);
+    signedLimbs at1 = even, atMinus1 = even;
+    addSigned(at1, x1);
+    addSigned(atMinus1, x1, true);
+    signedLimbs atMinus2 = atMinus1;
+    addSigned(atMinus2, x2);
+    shiftLeft1(atMinus2);
+    addSigned(atMinus2, x0, true);
+    return std::array<signedLimbs, 3>{at1, atMinus1, atMinus2};
+  };
+  signedLimbs a0 = part(a, aSize, 0), a1 = part(a, aSize, 1), a2 = part(a, aSize, 2);
+  signedLimbs b0 = part(b, bSize, 0), b1 = part(b, bSize, 1), b2 = part(b, bSize, 2);
+  std::array<signedLimbs, 3> aValues = evaluate(a0, a1, a2), bValues = evaluate(b0, b1, b2);
+
+  signedLimbs r0 = mulSigned(a0, b0);
+  signedLimbs r1 = mulSigned(aValues[0], bValues[0]);
+  signedLimbs rMinus1 = mulSigned(aValues[1], bValues[1]);
+  signedLimbs r3 = mulSigned(aValues[2], bValues[2]);
+  signedLimbs rInf = mulSigned(a2, b2);
+
+  addSigned(r3, r1, true);
+  divExact(r3, 3);
+  signedLimbs r2 = rMinus1;
+  addSigned(r2, r0, true);
+  addSigned(r1, rMinus1, true);
+  divExact(r1, 2);
+  // r3 = (r2 - r3) / 2 + 2 * rInf
+  addSigned(r3, r2, true);
+  r3.isNegative = !r3.isNegative && !r3.abs.empty();
+  divExact(r3, 2);
+  signedLimbs twiceInf = rInf;
+  shiftLeft1(twiceInf);
+  addSigned(r3, twiceInf);
+  addSigned(r2, r1);
+  addSigned(r2, rInf, true);
+  addSigned(r1, r3, true);
+
+  // the coefficients of the product are not negative and each of them fits under the top of the result
+  std::fill(res, res + size, 0);
+  const signedLimbs* coefficients[] = {&r0, &r1, &r2, &r3, &rInf};
+  for (size_t index = 0; index != 5; ++index) {
+    const std::vector<uint64_t>& coefficient = coefficients[index]->abs;
+    assert(!coefficients[index]->isNegative);
+    addTo(res + index * k, size - index * k, coefficient.data(), coefficient.size());
+  }
+}
+
+// base^exp mod mod
+constexpr uint32_t powMod(uint64_t base, uint64_t exp, uint32_t mod) {
+  uint64_t result = 1;
+  for (base %= mod; exp != 0; exp >>= 1) {
+    if (exp & 1) {
+      result = result * base % mod;
+    }
+    base = base * base % mod;
+  }
+  return static_cast<uint32_t>(result);
+}
+
+// Montgomery form x * 2^32 mod MOD of residues modulo an odd MOD < 2^31, multiplies without a division
+template <uint32_t MOD>
+constexpr uint32_t montgomeryNegInverse() {
+  uint32_t inverse = MOD; // inverse of MOD modulo 2^3, every Newton step doubles the bits
+  for (int i = 0; i != 4; ++i) {
+    inverse *= 2 - MOD * inverse;
+  }
+  return 0 - inverse;
+}
+
+// a - b mod MOD for a < 2 * MOD, b <= MOD. Without branches: they would be mispredicted half of the time.
+template <uint32_t MOD>
+uint32_t subMod(uint32_t a, uint32_t b) {
+  uint32_t diff = a - b;
+  return diff + (MOD & (0 - (diff >> 31)));
+}
+
+// t * 2^-32 mod MOD for t < MOD * 2^32
+template <uint32_t MOD>
+uint32_t montgomeryReduce(uint64_t t) {
+  uint32_t m = static_cast<uint32_t>(t) * montgomeryNegInverse<MOD>();
+  return subMod<MOD>(static_cast<uint32_t>((t + static_cast<uint64_t>(m) * MOD) >> 32), MOD);
+}
+
+template <uint32_t MOD>
+uint32_t montgomeryMul(uint32_t a, uint32_t b) {
+  return montgomeryReduce<MOD>(static_cast<uint64_t>(a) * b);
+}
+
+template <uint32_t MOD>
+uint32_t toMontgomery(uint32_t a) {
+  return montgomeryMul<MOD>(a, powMod(2, 64, MOD));
+}
+
+// Number-theoretic transform of length n = 2^k modulo a prime MOD = c * 2^k + 1 with the primitive root ROOT, not
+// scaled by 1 / n when inverted. The roots are in Montgomery form, so residues stay in the usual form.
+template <uint32_t MOD, uint32_t ROOT>
+void ntt(std::vector<uint32_t>& a, bool invert) {
+  size_t n = a.size();
+  for (size_t i = 1, j = 0; i < n; ++i) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(a[i], a[j]);
+    }
+  }
+  // roots[half + j] = w^j for the root w of order 2 * half, so every level reads its roots in order
+  std::vector<uint32_t> roots(n);
+  for (size_t half = 1; half < n; half <<= 1) {
+    uint32_t w = powMod(ROOT, (MOD - 1) / (2 * half), MOD);
+    w = toMontgomery<MOD>(invert ? powMod(w, MOD - 2, MOD) : w);
+    roots[half] = toMontgomery<MOD>(1);
+    for (size_t j = 1; j != half; ++j) {
+      roots[half + j] = montgomeryMul<MOD>(roots[half + j - 1], w);
+    }
+  }
+  for (size_t half = 1; half < n; half <<= 1) {
+    for (size_t i = 0; i < n; i += 2 * half) {
+      for (size_t j = 0; j != half; ++j) {
+        uint32_t u = a[i + j];
+        uint32_t v = montgomeryMul<MOD>(a[i + j + half], roots[half + j]);
+        a[i + j] = subMod<MOD>(u + v, MOD);
+        a[i + j + half] = subMod<MOD>(u, v);
+      }
+    }
+  }
+}
+
+// Cyclic convolution of length n modulo MOD of the 32-bit halves of the limbs, the lower half first;
+// b == nullptr squares a with one forward transform
+template <uint32_t MOD, uint32_t ROOT>
+std::vector<uint32_t> convolution(const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize, size_t n) {
+  auto transform = [n](const uint64_t* x, size_t xSize) {
+    std::vector<uint32_t> result(n);
+    for (size_t i = 0; i != xSize; ++i) {
+      result[2 * i] = static_cast<uint32_t>(x[i]) % MOD;
+      result[2 * i + 1] = static_cast<uint32_t>(x[i] >> 32) % MOD;
+    }
+    ntt<MOD, ROOT>(result, false);
+    return result;
+  };
+  std::vector<uint32_t> fa = transform(a, aSize);
+  if (b == nullptr) {
+    for (uint32_t& x : fa) {
+      x = montgomeryMul<MOD>(x, x);
+    }
+  } else {
+    std::vector<uint32_t> fb = transform(b, bSize);
+    for (size_t i = 0; i != n; ++i) {
+      fa[i] = montgomeryMul<MOD>(fa[i], fb[i]);
+    }
+  }
+  ntt<MOD, ROOT>(fa, true);
+  // the pointwise products lost a factor 2^32 and the inverse transform gained a factor n
+  uint32_t scale = static_cast<uint32_t>(static_cast<uint64_t>(powMod(n, MOD - 2, MOD)) * powMod(2, 64, MOD) % MOD);
+  for (uint32_t& x : fa) {
+    x = montgomeryMul<MOD>(x, scale);
+  }
+  return fa;
+}
+
+// The product of the primes exceeds 2^86, so a coefficient of the product of halves, below 2 * bSize * 2^64, is
+// found by the CRT while bSize <= 2^21 limbs. Transforms of the 2 * (aSize + bSize) halves are limited by the 2^25
+// roots of unity of the last prime.
+constexpr uint32_t NTT_PRIME1 = 2013265921; // 15 * 2^27 + 1
+constexpr uint32_t NTT_PRIME2 = 469762049;  // 7 * 2^26 + 1
+constexpr uint32_t NTT_PRIME3 = 167772161;  // 5 * 2^25 + 1
+constexpr size_t NTT_MAX_SIZE = size_t(1) << 24;
+constexpr size_t NTT_MAX_SHORTER = size_t(1) << 21;
+
+// res[0, aSize + bSize) = a * b by convolutions modulo three primes, each half of a limb is one coefficient
+void mulNtt(uint64_t* res, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  assert(bSize <= NTT_MAX_SHORTER && aSize + bSize <= NTT_MAX_SIZE);
+  size_t halves = 2 * (aSize + bSize);
+  size_t n = 1;
+  while (n < halves - 1) {
+    n <<= 1;
+  }
+  const uint64_t* other = aSize == bSize && std::equal(a, a + aSize, b) ? nullptr : b;
+  std::vector<uint32_t> r1 = convolution<NTT_PRIME1, 31>(a, aSize, other, bSize, n);
+  std::vector<uint32_t> r2 = convolution<NTT_PRIME2, 3>(a, aSize, other, bSize, n);
+  std::vector<uint32_t> r3 = convolution<NTT_PRIME3, 3>(a, aSize, other, bSize, n);
+
+  // Garner's form x = x1 + x2 * p1 + x3 * p1 * p2 with xi < pi
+  constexpr uint64_t p1Inverse2 = powMod(NTT_PRIME1, NTT_PRIME2 - 2, NTT_PRIME2);
+  constexpr uint64_t p12Inverse3 =
+      powMod(static_cast<uint64_t>(NTT_PRIME1) * NTT_PRIME2, NTT_PRIME3 - 2, NTT_PRIME3);
+  constexpr uint64_t p12 = static_cast<uint64_t>(NTT_PRIME1) * NTT_PRIME2;
+  constexpr uint64_t mask = std::numeric_limits<uint32_t>::max();
+
+  // the coefficients are below 2^87, so the carry into the next half is below 2^56
+  uint64_t carry = 0;
+  for (size_t i = 0; i != halves; ++i) {
+    uint64_t x1 = 0;
+    uint64_t x2 = 0;
+    uint64_t x3 = 0;
+    if (i != halves - 1) {
+      x1 = r1[i];
+      x2 = (r2[i] + NTT_PRIME2 - x1 % NTT_PRIME2) * p1Inverse2 % NTT_PRIME2;
+      x3 = (r3[i] + NTT_PRIME3 - (x1 + x2 * NTT_PRIME1) % NTT_PRIME3) * p12Inverse3 % NTT_PRIME3;
+    }
+    uint64_t low = x1 + x2 * NTT_PRIME1;
+    uint64_t highLow = x3 * (p12 & mask);
+    uint64_t limb = (low & mask) + (highLow & mask) + (carry & mask);
+    if (i % 2 == 0) {
+      res[i / 2] = limb & mask;
+    } else {
+      res[i / 2] |= limb << 32;
+    }
+    carry = (low >> 32) + (highLow >> 32) + x3 * (p12 >> 32) + (carry >> 32) + (limb >> 32);
+  }
+  assert(carry == 0);
+}
+
+// res[0, aSize + bSize) = a * b, res doesn't overlap the operands
+void mulLimbs(uint64_t* res, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  if (aSize < bSize) {
+    std::swap(a, b);
+    std::swap(aSize, bSize);
+  }
+  if (bSize < KARATSUBA_THRESHOLD) {
+    mulSchoolbook(res, a, aSize, b, bSize);
+  } else if (bSize >= NTT_THRESHOLD && bSize <= NTT_MAX_SHORTER && aSize + bSize <= NTT_MAX_SIZE) {
+    mulNtt(res, a, aSize, b, bSize);
+  } else if (2 * bSize <= aSize + 1) {
+    // too unbalanced to split both operands: a is multiplied by b in pieces of bSize limbs
+    std::fill(res, res + aSize + bSize, 0);
+    std::vector<uint64_t> piece(2 * bSize);
+    for (size_t offset = 0; offset < aSize; offset += bSize) {
+      size_t pieceSize = std::min(bSize, aSize - offset);
+      mulLimbs(piece.data(), a + offset, pieceSize, b, bSize);
+      addTo(res + offset, aSize + bSize - offset, piece.data(), pieceSize + bSize);
+    }
+  } else if (bSize >= TOOM3_THRESHOLD && 3 * bSize > 2 * aSize + 4) {
+    mulToom3(res, a, aSize, b, bSize);
+  } else {
+    mulKaratsuba(res, a, aSize, b, bSize);
+  }
+}
+
+// Divisors and quotients at least this long are divided by the Burnikel-Ziegler recursion,
+// which halves the divisor until it is shorter than BURNIKEL_ZIEGLER_LEAF limbs
+constexpr size_t BURNIKEL_ZIEGLER_THRESHOLD = 100;
+constexpr size_t BURNIKEL_ZIEGLER_LEAF = 24;
+// Divisions of operands this short together don't allocate scratch memory
+constexpr size_t DIVISION_STACK_LIMBS = 32;
+
+// Decimal conversions split numbers in halves down to this many chunks of SHIFT_MAX_SIZE digits
+constexpr size_t DECIMAL_LEAF_CHUNKS = 16;
+
+int compareLimbs(const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  aSize = trimmedSize(a, aSize);
+  bSize = trimmedSize(b, bSize);
+  if (aSize != bSize) {
+    return aSize < bSize ? -1 : 1;
+  }
+  for (size_t index = aSize; index != 0; --index) {
+    if (a[index - 1] != b[index - 1]) {
+      return a[index - 1] < b[index - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// Knuth's algorithm D: q[0, aSize - bSize) = a / b, a[0, bSize) = a % b and the rest of a is zeroed.
+// b is normalised, its top bit is set, and the top bSize limbs of a are less than b.
+void divKnuth(uint64_t* q, uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  uint64_t top = b[bSize - 1];
+  uint64_t second = bSize > 1 ? b[bSize - 2] : 0;
+  for (size_t j = aSize - bSize; j-- != 0;) {
+    uint64_t* window = a + j;
+    // the top two limbs of the window divided by the top limb of b exceed the quotient limb by at most 2,
+    // the third limbs of both correct it by all but 1
+    uint64_t qHat = std::numeric_limits<uint64_t>::max();
+    uint64_t rHat = window[bSize - 1] + top;
+    // rHat is the true remainder unless it overflows, and then qHat * second can't exceed it
+    bool rHatOverflow = rHat < top;
+    if (window[bSize] != top) {
+      qHat = divWide(window[bSize], window[bSize - 1], top, rHat);
+      rHatOverflow = false;
+    }
+    uint64_t third = bSize > 1 ? window[bSize - 2] : 0;
+    while (!rHatOverflow) {
+      uint64_t productHigh;
+      uint64_t productLow = mulWide(qHat, second, productHigh);
+      if (productHigh < rHat || (productHigh == rHat && productLow <= third)) {
+        break;
+      }
+      --qHat;
+      rHat += top;
+      rHatOverflow = rHat < top;
+    }
+    uint64_t borrow = subMulRow(window, b, bSize, qHat);
+    bool negative = window[bSize] < borrow;
+    window[bSize] -= borrow;
+    if (negative) {
+      --qHat;
+      addTo(window, bSize + 1, b, bSize);
+    }
+    q[j] = qHat;
+  }
+}
+
+void divBurnikelZiegler(uint64_t* q, uint64_t* a, const uint64_t* b, size_t n);
+
+// q[0, k) = a[0, 3k) / b[0, 2k), a[0, 2k) = the remainder, a[2k, 3k) is zeroed; the top 2k limbs of a are less than b
+void div3by2(uint64_t* q, uint64_t* a, const uint64_t* b, size_t k) {
+  if (compareLimbs(a + 2 * k, k, b + k, k) < 0) {
+    divBurnikelZiegler(q, a + k, b + k, k);
+  } else {
+    // the quotient by the top half of b is B^k - 1, a[k, 3k) - (B^k - 1) * b[k, 2k) fits in 2k limbs
+    std::fill(q, q + k, std::numeric_limits<uint64_t>::max());
+    subFrom(a + 2 * k, k, b + k, k);
+    addTo(a + k, 2 * k, b + k, k);
+  }
+  // a holds the remainder by the top half of b followed by the low k limbs, the estimate q is at most 2 too large
+  std::vector<uint64_t> product(2 * k);
+  mulLimbs(product.data(), q, k, b, k);
+  while (compareLimbs(a, 3 * k, product.data(), 2 * k) < 0) {
+    addTo(a, 3 * k, b, 2 * k);
+    for (size_t index = 0; q[index]-- == 0; ++index) {}
+  }
+  subFrom(a, 3 * k, product.data(), 2 * k);
+}
+
+// q[0, n) = a[0, 2n) / b[0, n), a[0, n) = the remainder, a[n, 2n) is zeroed; b is normalised and a[n, 2n) < b
+void divBurnikelZiegler(uint64_t* q, uint64_t* a, const uint64_t* b, size_t n) {
+  if (n % 2 != 0 || n < BURNIKEL_ZIEGLER_LEAF) {
+    divKnuth(q, a, 2 * n, b, n);
+    return;
+  }
+  size_t k = n / 2;
+  div3by2(q + k, a + k, b, k);
+  div3by2(q, a, b, k);
+}
 
-big_integer::big_integer(unsigned long long a) : data(a > MAX_UNIT_VAL ? 2 : 1), isNegative(false) {
-  data[0] = static_cast<uint32_t>(a);
-  a >>= 32;
-  if (a > 0) {
-    data[1] = a;
+// q = a / b, r = a % b for b != 0
+void divLimbs(limb_vector& q, limb_vector& r, const uint64_t* a, size_t aSize, const uint64_t* b, size_t bSize) {
+  aSize = trimmedSize(a, aSize);
+  bSize = trimmedSize(b, bSize);
+  assert(bSize != 0);
+  if (aSize < bSize) {
+    q.assign(1, 0);
+    r.assign(std::max<size_t>(aSize, 1), 0);
+    std::copy(a, a + aSize, r.data());
+    return;
   }
+  if (bSize == 1) {
+    q.assign(aSize, 0);
+    uint64_t* quotient = q.data();
+    uint64_t remainder = 0;
+    for (size_t index = aSize; index-- != 0;) {
+      quotient[index] = divWide(remainder, a[index], b[0], remainder);
+    }
+    r.assign(1, remainder);
+    return;
+  }
+  // b is shifted until its top bit is set; for the recursion it is also padded with zero limbs to n = j * 2^i limbs,
+  // j < BURNIKEL_ZIEGLER_LEAF, so that halving it reaches the leaves. a is scaled by the same factor.
+  bool recursive = bSize >= BURNIKEL_ZIEGLER_THRESHOLD && aSize - bSize >= BURNIKEL_ZIEGLER_THRESHOLD;
+  size_t n = bSize;
+  if (recursive) {
+    size_t blocks = 1;
+    while (bSize / blocks >= BURNIKEL_ZIEGLER_LEAF) {
+      blocks *= 2;
+    }
+    n = (bSize + blocks - 1) / blocks * blocks;
+  }
+  size_t padding = n - bSize;
+  int bits = std::countl_zero(b[bSize - 1]);
+  // a limb is shifted right by 64 - bits in two steps, as that may be 64
+  auto normalise = [&](uint64_t* result, const uint64_t* source, size_t size) {
+    for (size_t index = 0; index != size; ++index) {
+      result[padding + index] |= source[index] << bits;
+      result[padding + index + 1] |= source[index] >> 1 >> (63 - bits);
+    }
+  };
+  // the top limb of the dividend stays zero, so its top n limbs are less than the divisor
+  size_t dividendSize = aSize + padding + 2;
+  if (recursive) {
+    dividendSize = (dividendSize + n - 1) / n * n;
+  }
+  // both copies share one buffer, which is on the stack for short operands
+  std::array<uint64_t, DIVISION_STACK_LIMBS> stackScratch{};
+  std::vector<uint64_t> heapScratch;
+  uint64_t* divisor = stackScratch.data();
+  if (n + 1 + dividendSize > stackScratch.size()) {
+    heapScratch.resize(n + 1 + dividendSize);
+    divisor = heapScratch.data();
+  }
+  uint64_t* dividend = divisor + n + 1;
+  normalise(divisor, b, bSize);
+  normalise(dividend, a, aSize);
+
+  q.assign(dividendSize - n, 0);
+  if (recursive) {
+    for (size_t block = dividendSize / n - 1; block-- != 0;) {
+      divBurnikelZiegler(q.data() + block * n, dividend + block * n, divisor, n);
+    }
+  } else {
+    divKnuth(q.data(), dividend, dividendSize, divisor, n);
+  }
+  r.assign(bSize, 0);
+  uint64_t* remainder = r.data();
+  for (size_t index = 0; index != bSize; ++index) {
+    remainder[index] = dividend[padding + index] >> bits | dividend[padding + index + 1] << 1 << (63 - bits);
+  }
+}
+} // namespace
+
+struct limb_vector::shared_buffer {
+  size_t capacity;
+  // copies may live on different threads
+  std::atomic<size_t> refCount;
+
+  uint64_t* limbs() noexcept {
+    return reinterpret_cast<uint64_t*>(this + 1);
+  }
+
+  static shared_buffer* create(size_t capacity) {
+    void* memory = operator new(sizeof(shared_buffer) + capacity * sizeof(uint64_t));
+    return new (memory) shared_buffer{capacity, 1};
+  }
+};
+
+limb_vector::limb_vector() noexcept : limbCount(0), isSmall(true), storage() {}
+
+limb_vector::limb_vector(size_t size, uint64_t value) : limbCount(size), isSmall(size <= SMALL_SIZE), storage() {
+  if (!isSmall) {
+    storage.outer = shared_buffer::create(size);
+  }
+  std::fill(data(), data() + size, value);
+}
+
+limb_vector::limb_vector(const limb_vector& other) noexcept
+    : limbCount(other.limbCount),
+      isSmall(other.isSmall),
+      storage(other.storage) {
+  if (!isSmall) {
+    storage.outer->refCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+limb_vector::limb_vector(limb_vector&& other) noexcept
+    : limbCount(other.limbCount),
+      isSmall(other.isSmall),
+      storage(other.storage) {
+  other.limbCount = 0;
+  other.isSmall = true;
+}
+
+limb_vector& limb_vector::operator=(const limb_vector& other) noexcept {
+  limb_vector copy(other);
+  swap(copy);
+  return *this;
+}
+
+limb_vector& limb_vector::operator=(limb_vector&& other) noexcept {
+  limb_vector moved(std::move(other));
+  swap(moved);
+  return *this;
+}
+
+limb_vector::~limb_vector() {
+  release();
+}
+
+void limb_vector::release() noexcept {
+  if (!isSmall && storage.outer->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    storage.outer->~shared_buffer();
+    operator delete(storage.outer);
+  }
+}
+
+size_t limb_vector::size() const noexcept {
+  return limbCount;
 }
 
+size_t limb_vector::capacity() const noexcept {
+  return isSmall ? SMALL_SIZE : storage.outer->capacity;
+}
+
+// Moves the limbs to an own buffer of newCapacity > SMALL_SIZE limbs
+void limb_vector::reallocate(size_t newCapacity) {
+  shared_buffer* buffer = shared_buffer::create(newCapacity);
+  const uint64_t* limbs = std::as_const(*this).data();
+  std::copy(limbs, limbs + std::min(limbCount, newCapacity), buffer->limbs());
+  release();
+  storage.outer = buffer;
+  isSmall = false;
+}
+
+uint64_t* limb_vector::data() {
+  if (isSmall) {
+    return storage.inner;
+  }
+  if (storage.outer->refCount.load(std::memory_order_acquire) != 1) {
+    reallocate(storage.outer->capacity);
+  }
+  return storage.outer->limbs();
+}
+
+const uint64_t* limb_vector::data() const noexcept {
+  return isSmall ? storage.inner : storage.outer->limbs();
+}
+
+uint64_t& limb_vector::operator[](size_t index) {
+  return data()[index];
+}
+
+uint64_t limb_vector::operator[](size_t index) const noexcept {
+  return data()[index];
+}
+
+void limb_vector::resize(size_t newSize) {
+  // a shared buffer stays shared until it is written to
+  if (newSize == limbCount) {
+    return;
+  }
+  if (newSize <= SMALL_SIZE) {
+    if (!isSmall) {
+      uint64_t limbs[SMALL_SIZE] = {};
+      std::copy(storage.outer->limbs(), storage.outer->limbs() + std::min(limbCount, newSize), limbs);
+      release();
+      isSmall = true;
+      std::copy(limbs, limbs + SMALL_SIZE, storage.inner);
+    }
+  } else if (isSmall || newSize > capacity() || storage.outer->refCount.load(std::memory_order_acquire) != 1) {
+    reallocate(newSize > capacity() ? std::max(newSize, 2 * capacity()) : capacity());
+  }
+  if (newSize > limbCount) {
+    std::fill(data() + limbCount, data() + newSize, 0);
+  }
+  limbCount = newSize;
+}
+
+void limb_vector::assign(size_t count, uint64_t value) {
+  limb_vector result(count, value);
+  swap(result);
+}
+
+void limb_vector::swap(limb_vector& other) noexcept {
+  std::swap(limbCount, other.limbCount);
+  std::swap(isSmall, other.isSmall);
+  std::swap(storage, other.storage);
+}
+
+bool operator==(const limb_vector& a, const limb_vector& b) noexcept {
+  return a.size() == b.size() && std::equal(a.data(), a.data() + a.size(), b.data());
+}
+
+big_integer::big_integer() noexcept : data(), isNegative(false) {}
+
+big_integer::big_integer(const big_integer& other) noexcept = default;
+
+big_integer::big_integer(big_integer&& other) noexcept = default;
+
+big_integer::big_integer(unsigned long long a) : data(1, a), isNegative(false) {}
+
 big_integer::big_integer(long long a)
     : big_integer(static_cast<unsigned long long>(a >= 0 ? a : static_cast<unsigned long long>(-(a + 1)) + 1)) {
   isNegative = a < 0;
@@ -39,28 +950,53 @@ big_integer::big_integer(unsigned short a) : big_integer(static_cast<unsigned lo
 big_integer::big_integer(short a) : big_integer(static_cast<long long>(a)) {}
 
 big_integer::big_integer(const std::string& str) : big_integer(0) {
-  isNegative = false;
-  size_t index = str[0] == '-' ? 1 : 0;
-  while (index < str.size() && str[index] >= '0' && str[index] <= '9') {
-    size_t dif_index = 0;
-    uint32_t addNum = std::stoi(str.substr(index, SHIFT_MAX_SIZE), &dif_index);
-    index += dif_index;
-    if (dif_index == 0) {
-      break;
+  size_t begin = !str.empty() && str[0] == '-' ? 1 : 0;
+  if (begin == str.size() ||
+      !std::all_of(str.begin() + begin, str.end(), [](char digit) { return digit >= '0' && digit <= '9'; })) {
+    throw std::invalid_argument("incorrect format: " + str);
+  }
+  // chunks of SHIFT_MAX_SIZE digits, the lowest first, are read in place and gathered into groups of
+  // DECIMAL_LEAF_CHUNKS; then neighbouring groups are merged, the higher one scaled by a power of SHIFT_MAX
+  size_t chunks = (str.size() - begin + SHIFT_MAX_SIZE - 1) / SHIFT_MAX_SIZE;
+  std::vector<big_integer> groups((chunks + DECIMAL_LEAF_CHUNKS - 1) / DECIMAL_LEAF_CHUNKS, big_integer(0));
+  for (size_t chunk = chunks; chunk-- != 0;) {
+    size_t last = str.size() - chunk * SHIFT_MAX_SIZE;
+    size_t first = last - begin < SHIFT_MAX_SIZE ? begin : last - SHIFT_MAX_SIZE;
+    uint64_t value = 0;
+    for (size_t index = first; index != last; ++index) {
+      value = value * 10 + static_cast<uint64_t>(str[index] - '0');
     }
-    mulChange(dif_index == SHIFT_MAX_SIZE ? SHIFT_MAX : std::pow(10, dif_index));
-    add(addNum);
+    groups[chunk / DECIMAL_LEAF_CHUNKS].mulChange(SHIFT_MAX, value);
   }
-  if (index != str.size() || str.empty() || str[index - 1] < '0' || str[index - 1] > '9') {
-    throw std::invalid_argument("incorrect format: " + str);
+  big_integer power(1);
+  for (size_t index = 0; index != DECIMAL_LEAF_CHUNKS; ++index) {
+    power.mulChange(SHIFT_MAX);
   }
-  isNegative = str[0] == '-';
+  while (groups.size() > 1) {
+    for (size_t index = 0; 2 * index < groups.size(); ++index) {
+      if (2 * index + 1 < groups.size()) {
+        groups[2 * index + 1] *= power;
+        groups[2 * index + 1] += groups[2 * index];
+        groups[index].swap(groups[2 * index + 1]);
+      } else {
+        groups[index].swap(groups[2 * index]);
+      }
+    }
+    groups.resize((groups.size() + 1) / 2);
+    if (groups.size() > 1) {
+      power *= power;
+    }
+  }
+  swap(groups[0]);
+  isNegative = begin == 1;
   checkZero();
 }
 
 big_integer::~big_integer() = default;
 
-big_integer::big_integer(size_t size, uint32_t initValue) : data(size, initValue), isNegative(false) {}
+big_integer& big_integer::operator=(big_integer&& other) noexcept = default;
+
+big_integer::big_integer(size_t size, uint64_t initValue) : data(size, initValue), isNegative(false) {}
 
 big_integer& big_integer::operator=(const big_integer& other) {
   if (&other == this) {
@@ -85,38 +1021,37 @@ void big_integer::equalizeSize(const big_integer& rhs) {
   }
 }
 
-uint32_t& big_integer::getUnit(size_t pos) {
+uint64_t& big_integer::getUnit(size_t pos) {
   return data[pos];
 }
 
-uint32_t big_integer::getUnit(size_t pos) const {
+uint64_t big_integer::getUnit(size_t pos) const {
   return data[pos];
 }
 
-uint32_t& big_integer::firstData() {
+uint64_t& big_integer::firstData() {
   return data[dataSize() - 1];
 }
 
-uint32_t big_integer::firstData() const {
+uint64_t big_integer::firstData() const {
   return data[dataSize() - 1];
 }
 
-uint32_t& big_integer::lastData() {
+uint64_t& big_integer::lastData() {
   return data[0];
 }
 
-uint32_t big_integer::lastData() const {
+uint64_t big_integer::lastData() const {
   return data[0];
 }
 
 void big_integer::swap(big_integer& swapper) noexcept {
   std::swap(isNegative, swapper.isNegative);
-  std::swap(data, swapper.data);
+  data.swap(swapper.data);
 }
 
 void big_integer::checkZero() noexcept {
-  size_t firstNotZero;
-  for (firstNotZero = dataSize(); firstNotZero != 0 && getUnit(firstNotZero - 1) == 0; --firstNotZero) {}
+  size_t firstNotZero = trimmedSize(std::as_const(data).data(), dataSize());
   if (firstNotZero == 0) {
     firstNotZero = 1;
     isNegative = false;
@@ -125,90 +1060,55 @@ void big_integer::checkZero() noexcept {
 }
 
 void big_integer::add(const int32_t shift) {
-  int64_t carry = shift * (isNegative ? -1 : 1);
-  if (firstData() == std::numeric_limits<uint32_t>::max()) {
-    changeSize(dataSize() + 1);
-  }
-  for (size_t index = 0; carry != 0 && index != dataSize(); index++) {
-    carry += getUnit(index);
-    getUnit(index) = carry;
-    carry >>= 32;
-  }
-  if (carry != 0) {
-    firstData() = carry;
+  // the magnitude changes by delta and goes below zero only from a single limb
+  int64_t delta = static_cast<int64_t>(shift) * (isNegative ? -1 : 1);
+  uint64_t value = delta < 0 ? 0 - static_cast<uint64_t>(delta) : static_cast<uint64_t>(delta);
+  if (delta >= 0) {
+    if (firstData() == MAX_UNIT_VAL) {
+      changeSize(dataSize() + 1);
+    }
+    addTo(data.data(), dataSize(), &value, 1);
+  } else if (dataSize() == 1 && lastData() < value) {
+    lastData() = value - lastData();
+    isNegative = !isNegative;
+  } else {
+    subFrom(data.data(), dataSize(), &value, 1);
   }
   checkZero();
 }
 
-void big_integer::addWithShift(uint64_t delta, const size_t shift) {
-  uint64_t carry = delta >> 32;
-  delta %= SHIFT;
-  delta += getUnit(shift);
-  getUnit(shift) = delta;
-  carry += delta >> 32;
-  for (size_t index = shift + 1; carry != 0 && index != dataSize(); index++) {
-    carry += getUnit(index);
-    getUnit(index) = carry;
-    carry >>= 32;
-  }
-  if (carry != 0) {
-    firstData() = carry;
+big_integer& big_integer::addSigned(const big_integer& rhs, bool subtract) {
+  // rhs may be *this, so its size and sign are read before anything changes
+  size_t rhsSize = rhs.dataSize();
+  bool rhsNegative = rhs.isNegative ^ subtract;
+  if (isNegative == rhsNegative) {
+    changeSize(std::max(dataSize(), rhsSize) + 1);
+    addTo(data.data(), dataSize(), rhs.data.data(), rhsSize);
+  } else if (compareLimbs(std::as_const(data).data(), dataSize(), rhs.data.data(), rhsSize) >= 0) {
+    subFrom(data.data(), dataSize(), rhs.data.data(), rhsSize);
+  } else {
+    changeSize(rhsSize);
+    subFromReversed(data.data(), rhs.data.data(), rhsSize);
+    isNegative = rhsNegative;
   }
+  checkZero();
+  return *this;
 }
 
 big_integer& big_integer::operator+=(const big_integer& rhs) {
-  equalizeSize(rhs);
-  uint64_t carry = 0;
-  isNegative = !isNegative;
-  bool changeSign = ((!isNegative) && (rhs > *this)) || (isNegative && (rhs < *this));
-  isNegative = !isNegative;
-  if ((dataSize() == rhs.dataSize() && firstData() > MAX_UNIT_VAL - rhs.firstData()) || firstData() == MAX_UNIT_VAL) {
-    changeSize(dataSize() + 1);
-  }
-  for (size_t index = 0; index != rhs.dataSize(); index++) {
-    if (isNegative == rhs.isNegative) {
-      carry = getUnit(index) + carry + rhs.getUnit(index);
-    } else if (changeSign) {
-      carry = rhs.getUnit(index) - carry - getUnit(index);
-    } else {
-      carry = getUnit(index) - carry - rhs.getUnit(index);
-    }
-    getUnit(index) = carry;
-    carry = carry > MAX_UNIT_VAL ? 1 : 0;
-  }
-  for (size_t index = rhs.dataSize(); carry != 0 && index != dataSize(); index++) {
-    if (isNegative == rhs.isNegative) {
-      carry = getUnit(index) + carry;
-    } else if (changeSign) {
-      carry = -getUnit(index) - carry;
-    } else {
-      carry = getUnit(index) - carry;
-    }
-    getUnit(index) = carry;
-    carry = carry > MAX_UNIT_VAL ? 1 : 0;
-  }
-  if (carry == 1) {
-    firstData() = 1;
-  }
-  isNegative = isNegative ^ changeSign;
-  checkZero();
-  return *this;
+  return addSigned(rhs, false);
 }
 
 big_integer& big_integer::operator-=(const big_integer& rhs) {
-  isNegative = !isNegative;
-  *this += rhs;
-  isNegative = !isNegative;
-  checkZero();
-  return *this;
+  return addSigned(rhs, true);
 }
 
-big_integer& big_integer::mulChange(const uint32_t scalar) {
-  uint64_t carry = 0, res, scalar64 = scalar;
+big_integer& big_integer::mulChange(const uint64_t scalar, uint64_t addend) {
+  uint64_t carry = addend, high;
   for (size_t index = 0; index != dataSize(); ++index) {
-    res = carry + getUnit(index) * scalar64;
-    getUnit(index) = res;
-    carry = res >> 32;
+    uint64_t low = mulWide(getUnit(index), scalar, high) + carry;
+    getUnit(index) = low;
+    carry = high + (low < carry ? 1 : 0);
   }
   if (carry != 0) {
     changeSize(dataSize() + 1);
@@ -218,34 +1118,19 @@ big_integer& big_integer::mulChange(const uint32_t scalar) {
   return *this;
 }
 
-big_integer mul(const big_integer& lhs, const uint32_t scalar) {
-  big_integer newNumber(lhs);
-  return newNumber.mulChange(scalar);
-}
-
 big_integer& big_integer::operator*=(const big_integer& rhs) {
-  size_t index1 = dataSize();
-  changeSize(dataSize() + rhs.dataSize() -
-             (static_cast<uint64_t>(firstData()) * rhs.firstData() > MAX_UNIT_VAL ? 0 : 1));
-  for (; index1 != 0; --index1) {
-    uint64_t val = getUnit(index1 - 1);
-    getUnit(index1 - 1) = 0;
-    for (size_t index2 = 0; index2 != rhs.dataSize(); ++index2) {
-      addWithShift(val * rhs.getUnit(index2), index1 + index2 - 1);
-    }
-  }
-  isNegative = isNegative ^ rhs.isNegative;
-  checkZero();
+  big_integer result(dataSize() + rhs.dataSize(), 0);
+  mulLimbs(result.data.data(), std::as_const(data).data(), dataSize(), rhs.data.data(), rhs.dataSize());
+  result.isNegative = isNegative ^ rhs.isNegative;
+  result.checkZero();
+  swap(result);
   return *this;
 }
 
-uint32_t big_integer::scalarDivMod(uint32_t scalar) {
+uint64_t big_integer::scalarDivMod(uint64_t scalar) {
   uint64_t carry = 0;
   for (size_t index = dataSize(); index != 0; --index) {
-    carry <<= 32;
-    carry += getUnit(index - 1);
-    getUnit(index - 1) = carry / scalar;
-    carry %= scalar;
+    getUnit(index - 1) = divWide(carry, getUnit(index - 1), scalar, carry);
   }
   checkZero();
   return carry;
@@ -253,78 +1138,14 @@ uint32_t big_integer::scalarDivMod(uint32_t scalar) {
 
 big_integer big_integer::operatorDivMod(const big_integer& rhs, bool returnQuot) {
   assert(rhs != 0);
-  bool isOldNeg = isNegative;
-  isNegative = rhs.isNegative;
-  if ((rhs.isNegative && *this > rhs) || (!rhs.isNegative && *this < rhs)) {
-    big_integer newNumber(0);
-    isNegative = isOldNeg;
-    if (returnQuot) {
-      swap(newNumber);
-    }
-    checkZero();
-    return newNumber;
-  }
-  isNegative = isOldNeg;
-  uint64_t elementaryQuot, mainDivider;
-  bool finalSign = isNegative ^ rhs.isNegative;
-  isNegative = rhs.isNegative;
-  size_t n, m;
-  for (size_t index = rhs.dataSize() - 1;; --index) {
-    if (rhs.getUnit(index) != 0) {
-      mainDivider = rhs.getUnit(index);
-      n = index + 1;
-      m = dataSize() - n;
-      break;
-    }
-  }
-  big_integer quot(m + 1, 0);
-  for (size_t index = m; dataSize() >= n; --index) {
-    if (n + index >= dataSize()) {
-      elementaryQuot = getUnit(n + index - 1) / mainDivider;
-    } else {
-      elementaryQuot = (getUnit(n + index) * SHIFT + getUnit(n + index - 1)) / mainDivider;
-    }
-    if (elementaryQuot == 0) {
-      if (index == 0) {
-        break;
-      }
-      continue;
-    }
-    uint32_t quotAtom = 0;
-    while (true) {
-      big_integer shiftBigInt(mul(rhs, elementaryQuot) << (index * 32));
-      *this -= shiftBigInt;
-      quotAtom += elementaryQuot;
-      if (isNegative == rhs.isNegative || *this == 0) {
-        break;
-      }
-      elementaryQuot = (elementaryQuot + 1) / 2;
-      shiftBigInt = mul(rhs, elementaryQuot) << (index * 32);
-      *this += shiftBigInt;
-      quotAtom -= elementaryQuot;
-      if (n + index - 1 >= dataSize() ||
-          ((n + index >= dataSize() || getUnit(n + index) == 0) && getUnit(n + index - 1) < rhs.getUnit(n - 1))) {
-        break;
-      }
-      if (n + index >= dataSize()) {
-        elementaryQuot = getUnit(n + index - 1) / mainDivider;
-      } else {
-        elementaryQuot = (getUnit(n + index) * SHIFT + getUnit(n + index - 1)) / mainDivider;
-      }
-    }
-    quot.getUnit(index) = quotAtom;
-    if (index == 0) {
-      break;
-    }
-  }
-  quot.isNegative = finalSign;
-  isNegative = isOldNeg;
-  if (returnQuot) {
-    swap(quot);
-  }
-  checkZero();
+  big_integer quot, rem;
+  divLimbs(quot.data, rem.data, std::as_const(data).data(), dataSize(), rhs.data.data(), rhs.dataSize());
+  quot.isNegative = isNegative ^ rhs.isNegative;
+  rem.isNegative = isNegative;
   quot.checkZero();
-  return quot;
+  rem.checkZero();
+  swap(returnQuot ? quot : rem);
+  return returnQuot ? rem : quot;
 }
 
 big_integer& big_integer::operator/=(const big_integer& rhs) {
@@ -337,31 +1158,44 @@ big_integer& big_integer::operator%=(const big_integer& rhs) {
   return *this;
 }
 
-big_integer& big_integer::logicOperator(const big_integer& rhs, uint32_t (*f)(uint32_t, uint32_t)) {
+template <typename Op>
+big_integer& big_integer::logicOperator(const big_integer& rhs, Op op) {
+  if (this == &rhs) {
+    return logicOperator(big_integer(rhs), op);
+  }
+  size_t rhsSize = rhs.dataSize();
+  if (!isNegative && !rhs.isNegative) {
+    // only and clears the bits of the longer operand that face the zero padding of the shorter one
+    changeSize(op(1u, 0u) == 0 ? std::min(dataSize(), rhsSize) : std::max(dataSize(), rhsSize));
+    size_t size = std::min(dataSize(), rhsSize);
+    bitwiseLimbs(data.data(), size, rhs.data.data(), size, 0, 0, 0, op);
+    checkZero();
+    return *this;
+  }
+  // A negative x is ~(|x| - 1) in two's complement, and so is a negative result
+  const uint64_t one = 1;
+  bool finalSign = op(static_cast<uint64_t>(isNegative), static_cast<uint64_t>(rhs.isNegative)) != 0;
+  uint64_t maskA = isNegative ? MAX_UNIT_VAL : 0, maskB = rhs.isNegative ? MAX_UNIT_VAL : 0,
+           maskRes = finalSign ? MAX_UNIT_VAL : 0;
   equalizeSize(rhs);
-  bool finalSign = f(isNegative, rhs.isNegative), carryA = isNegative, carryB = rhs.isNegative;
-  for (size_t index = 0; index != dataSize(); ++index) {
-    uint32_t a = isNegative ? ~getUnit(index) : getUnit(index),
-             b = rhs.isNegative ? (index < rhs.dataSize() ? ~rhs.getUnit(index) : MAX_UNIT_VAL)
-                                : (index < rhs.dataSize() ? rhs.getUnit(index) : 0);
-    if (carryA) {
-      carryA = a == MAX_UNIT_VAL;
-      a++;
-    }
-    if (carryB) {
-      carryB = b == MAX_UNIT_VAL;
-      b++;
-    }
-    a = f(a, b);
-    if (finalSign) {
-      getUnit(index) = ~a;
-    } else {
-      getUnit(index) = a;
+  uint64_t* a = data.data();
+  const uint64_t* b = rhs.data.data();
+  if (isNegative) {
+    subFrom(a, dataSize(), &one, 1);
+  }
+  size_t index = 0;
+  if (rhs.isNegative) {
+    // |rhs| - 1 differs from |rhs| only up to the lowest nonzero limb
+    for (; b[index] == 0; ++index) {
+      a[index] = op(a[index] ^ maskA, 0) ^ maskRes;
     }
+    a[index] = op(a[index] ^ maskA, ~(b[index] - 1)) ^ maskRes;
+    ++index;
   }
-  isNegative = false;
+  bitwiseLimbs(a + index, dataSize() - index, b + index, rhsSize - index, maskA, maskB, maskRes, op);
   if (finalSign) {
-    (*this)++;
+    changeSize(dataSize() + 1);
+    addTo(data.data(), dataSize(), &one, 1);
   }
   isNegative = finalSign;
   checkZero();
@@ -369,73 +1203,77 @@ big_integer& big_integer::logicOperator(const big_integer& rhs, uint32_t (*f)(ui
 }
 
 big_integer& big_integer::operator&=(const big_integer& rhs) {
-  return logicOperator(rhs, [](uint32_t a, uint32_t b) { return a & b; });
+  return logicOperator(rhs, [](uint64_t a, uint64_t b) { return a & b; });
 }
 
 big_integer& big_integer::operator|=(const big_integer& rhs) {
-  return logicOperator(rhs, [](uint32_t a, uint32_t b) { return a | b; });
+  return logicOperator(rhs, [](uint64_t a, uint64_t b) { return a | b; });
 }
 
 big_integer& big_integer::operator^=(const big_integer& rhs) {
-  return logicOperator(rhs, [](uint32_t a, uint32_t b) { return a ^ b; });
+  return logicOperator(rhs, [](uint64_t a, uint64_t b) { return a ^ b; });
 }
 
 big_integer& big_integer::operator<<=(int rhs) {
   assert(rhs >= 0);
-  if (rhs == 0) {
+  size_t size = dataSize();
+  if (rhs == 0 || size == 0) {
     return *this;
   }
-  const uint16_t SHIFT_LEFT = rhs % 32, SHIFT_RIGHT = 32 - rhs % 32, RIGHT_INDEX = (rhs + 31) / 32,
-                 LEFT_INDEX = rhs / 32;
-  changeSize(dataSize() + 1 + RIGHT_INDEX);
-  size_t index;
-  bool needClear = true;
-  for (index = dataSize() - 1; index >= LEFT_INDEX; --index) {
-    getUnit(index) = (getUnit(index - LEFT_INDEX) << SHIFT_LEFT);
-    if (index >= RIGHT_INDEX && SHIFT_LEFT != 0) {
-      getUnit(index) += (getUnit(index - RIGHT_INDEX) >> SHIFT_RIGHT);
-    }
-    if (index <= LEFT_INDEX) {
-      needClear = (index != 0);
-      index--;
-      break;
+  const size_t limbShift = rhs / 64;
+  const int bitShift = rhs % 64;
+  changeSize(size + limbShift + 1);
+  uint64_t* a = data.data();
+  // the limbs move up and across limb boundaries in one pass from the top
+  if (bitShift == 0) {
+    std::copy_backward(a, a + size, a + size + limbShift);
+  } else {
+    a[size + limbShift] = a[size - 1] >> (64 - bitShift);
+    for (size_t index = size - 1; index != 0; --index) {
+      a[index + limbShift] = (a[index] << bitShift) | (a[index - 1] >> (64 - bitShift));
     }
+    a[limbShift] = a[0] << bitShift;
   }
-  for (size_t clearIndex = 0; needClear && clearIndex <= index; ++clearIndex) {
-    getUnit(clearIndex) = 0;
-  }
+  std::fill(a, a + limbShift, 0);
   checkZero();
   return *this;
 }
 
 big_integer& big_integer::operator>>=(int rhs) {
   assert(rhs >= 0);
+  size_t size = dataSize();
   if (rhs == 0) {
     return *this;
   }
-  const uint16_t RIGHT_INDEX = (rhs + 31) / 32, LEFT_INDEX = rhs / 32, SHIFT = rhs % 32;
-  const uint64_t SHIFT_LEFT = (static_cast<uint64_t>(UINT32_MAX) + 1) >> SHIFT;
-  size_t index;
-  bool needRound = false;
-  for (index = 0; index < dataSize() && index < RIGHT_INDEX; ++index) {
-    needRound |= (getUnit(index) != 0);
+  const size_t limbShift = rhs / 64;
+  const int bitShift = rhs % 64;
+  if (limbShift >= size) {
+    return *this = isNegative ? -1 : 0;
   }
-  if (RIGHT_INDEX < dataSize()) {
-    needRound |= ((getUnit(RIGHT_INDEX) * SHIFT_LEFT) != 0);
+  // A negative x is shifted as -((|x| - 1) >> rhs) - 1, which rounds towards minus infinity
+  const uint64_t one = 1;
+  uint64_t* a = data.data();
+  if (isNegative) {
+    subFrom(a, size, &one, 1);
   }
-  for (index = 0; index + LEFT_INDEX < dataSize(); ++index) {
-    getUnit(index) = (getUnit(index + LEFT_INDEX) >> SHIFT);
-    if (index + RIGHT_INDEX < dataSize()) {
-      getUnit(index) += (getUnit(index + RIGHT_INDEX) * SHIFT_LEFT);
+  size_t newSize = size - limbShift;
+  if (bitShift == 0) {
+    std::copy(a + limbShift, a + size, a);
+  } else {
+    for (size_t index = 0; index + 1 != newSize; ++index) {
+      a[index] = (a[index + limbShift] >> bitShift) | (a[index + limbShift + 1] << (64 - bitShift));
     }
+    a[newSize - 1] = a[size - 1] >> bitShift;
   }
-  for (size_t clearIndex = index; clearIndex < dataSize(); ++clearIndex) {
-    getUnit(clearIndex) = 0;
+  if (isNegative) {
+    changeSize(newSize + 1);
+    a = data.data();
+    a[newSize] = 0;
+    addTo(a, newSize + 1, &one, 1);
+  } else {
+    changeSize(newSize);
   }
   checkZero();
-  if (needRound & isNegative) {
-    (*this)--;
-  }
   return *this;
 }
 
@@ -557,10 +1395,7 @@ bool operator<(const big_integer& a, const big_integer& b) {
   if (a.isNegative ^ b.isNegative) {
     return a.isNegative;
   }
-  return a.isNegative ^
-         (a.dataSize() < b.dataSize() ||
-          (a.dataSize() == b.dataSize() && std::lexicographical_compare(std::rbegin(a.data), std::rend(a.data),
-                                                                        std::rbegin(b.data), std::rend(b.data))));
+  return a.isNegative ^ (compareLimbs(a.data.data(), a.dataSize(), b.data.data(), b.dataSize()) < 0);
 }
 
 bool operator>(const big_integer& a, const big_integer& b) {
@@ -575,23 +1410,37 @@ bool operator>=(const big_integer& a, const big_integer& b) {
   return !(a < b);
 }
 
-std::string to_string(const big_integer& a) {
-  big_integer forStringInt(a);
-  std::string s;
-  while (true) {
-    std::string add = std::to_string(forStringInt.scalarDivMod(a.SHIFT_MAX));
-    std::reverse(add.begin(), add.end());
-    s.append(add);
-    if (forStringInt == 0) {
-      break;
-    } else {
-      s.append(a.SHIFT_MAX_SIZE - add.size(), '0');
+void big_integer::writeDecimal(const std::vector<big_integer>& powers, size_t level, char* out) {
+  size_t size = static_cast<size_t>(SHIFT_MAX_SIZE) << level;
+  if ((size_t(1) << level) <= DECIMAL_LEAF_CHUNKS) {
+    for (char* end = out + size; dataSize() != 1 || firstData() != 0; end -= SHIFT_MAX_SIZE) {
+      for (uint64_t chunk = scalarDivMod(SHIFT_MAX), digit = 0; digit != SHIFT_MAX_SIZE; ++digit, chunk /= 10) {
+        end[-1 - static_cast<ptrdiff_t>(digit)] = static_cast<char>('0' + chunk % 10);
+      }
     }
+    return;
+  }
+  big_integer low = operatorDivMod(powers[level - 1], true);
+  writeDecimal(powers, level - 1, out);
+  low.writeDecimal(powers, level - 1, out + size / 2);
+}
+
+std::string to_string(const big_integer& a) {
+  big_integer magnitude(a);
+  magnitude.isNegative = false;
+  // powers[k] = SHIFT_MAX^(2^k) are shared by all the splits, the magnitude is below SHIFT_MAX^(2^level)
+  std::vector<big_integer> powers{big_integer(a.SHIFT_MAX)};
+  while (powers.back() <= magnitude) {
+    powers.push_back(powers.back() * powers.back());
   }
+  size_t level = powers.size() - 1;
+  powers.pop_back();
+  std::string s(static_cast<size_t>(a.SHIFT_MAX_SIZE) << level, '0');
+  magnitude.writeDecimal(powers, level, s.data());
+  s.erase(0, std::min(s.find_first_not_of('0'), s.size() - 1));
   if (a.isNegative) {
-    s.push_back('-');
+    s.insert(s.begin(), '-');
   }
-  std::reverse(s.begin(), s.end());
   return s;
 }
 
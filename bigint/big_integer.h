@@ -1,23 +1,66 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 #include <limits>
 #include <string>
 #include <vector>
 
+// Limbs of a big_integer: up to SMALL_SIZE of them are stored inline, longer ones in a heap buffer shared by copies
+// until one of them is modified (small-object and copy-on-write, as socow_vector does)
+class limb_vector {
+public:
+  static constexpr size_t SMALL_SIZE = 4;
+
+  limb_vector() noexcept;
+  limb_vector(size_t size, uint64_t value);
+  limb_vector(const limb_vector& other) noexcept;
+  limb_vector(limb_vector&& other) noexcept;
+  limb_vector& operator=(const limb_vector& other) noexcept;
+  limb_vector& operator=(limb_vector&& other) noexcept;
+  ~limb_vector();
+
+  size_t size() const noexcept;
+  // The non-const accessors copy a shared buffer first
+  uint64_t* data();
+  const uint64_t* data() const noexcept;
+  uint64_t& operator[](size_t index);
+  uint64_t operator[](size_t index) const noexcept;
+  // New limbs are zero
+  void resize(size_t newSize);
+  void assign(size_t count, uint64_t value);
+  void swap(limb_vector& other) noexcept;
+
+  friend bool operator==(const limb_vector& a, const limb_vector& b) noexcept;
+
+private:
+  struct shared_buffer;
+
+  size_t capacity() const noexcept;
+  void reallocate(size_t newCapacity);
+  void release() noexcept;
+
+  size_t limbCount;
+  bool isSmall;
+  union {
+    uint64_t inner[SMALL_SIZE];
+    shared_buffer* outer;
+  } storage;
+};
+
 struct big_integer {
 private:
-  const uint64_t SHIFT = static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()) + 1;
-  const uint32_t MAX_UNIT_VAL = std::numeric_limits<uint32_t>::max();
-  const uint32_t SHIFT_MAX_SIZE = 9;
-  const uint32_t SHIFT_MAX = 1000000000;
-  std::vector<uint32_t> data;
+  static constexpr uint64_t MAX_UNIT_VAL = std::numeric_limits<uint64_t>::max();
+  static constexpr uint32_t SHIFT_MAX_SIZE = 19;
+  static constexpr uint64_t SHIFT_MAX = 10000000000000000000u;
+  limb_vector data;
   bool isNegative;
 
 public:
   big_integer() noexcept;
   big_integer(const big_integer& other) noexcept;
+  big_integer(big_integer&& other) noexcept;
   big_integer(int a);
   big_integer(long long a);
   big_integer(long a);
@@ -29,27 +72,31 @@ public:
   explicit big_integer(const std::string& str);
   ~big_integer();
   big_integer& operator=(const big_integer& other);
+  big_integer& operator=(big_integer&& other) noexcept;
 
 private:
   void checkZero() noexcept;
-  big_integer(size_t size, uint32_t initValue);
+  big_integer(size_t size, uint64_t initValue);
   void equalizeSize(const big_integer& rhs);
   void changeSize(size_t newSize);
   size_t dataSize() const;
-  uint32_t& getUnit(size_t pos);
-  uint32_t getUnit(size_t pos) const;
+  uint64_t& getUnit(size_t pos);
+  uint64_t getUnit(size_t pos) const;
   void add(const int32_t shift);
-  void addWithShift(uint64_t delta, const size_t shift);
   void swap(big_integer& swapper) noexcept;
-  uint32_t firstData() const;
-  uint32_t& firstData();
-  uint32_t lastData() const;
-  uint32_t& lastData();
-  friend big_integer mul(const big_integer& lhs, const uint32_t scalar);
-  big_integer& mulChange(const uint32_t scalar);
-  uint32_t scalarDivMod(uint32_t scalar);
-  big_integer& logicOperator(const big_integer& rhs, uint32_t (*f)(uint32_t, uint32_t));
+  uint64_t firstData() const;
+  uint64_t& firstData();
+  uint64_t lastData() const;
+  uint64_t& lastData();
+  big_integer& mulChange(const uint64_t scalar, uint64_t addend = 0);
+  uint64_t scalarDivMod(uint64_t scalar);
+  template <typename Op>
+  big_integer& logicOperator(const big_integer& rhs, Op op);
   big_integer operatorDivMod(const big_integer& rhs, bool returnQuot);
+  big_integer& addSigned(const big_integer& rhs, bool subtract);
+  // Writes the number, which is below SHIFT_MAX^(2^level), as (SHIFT_MAX_SIZE << level) digits with leading zeros
+  // and leaves it zero; out is filled with '0'. powers[k] = SHIFT_MAX^(2^k).
+  void writeDecimal(const std::vector<big_integer>& powers, size_t level, char* out);
 
 public:
   big_integer& operator+=(const big_integer& rhs);
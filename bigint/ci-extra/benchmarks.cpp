@@ -0,0 +1,294 @@
+#include "../big_integer.h"
+#include "big_integer_gmp.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+// Heap allocations made through operator new, see bm_small_mixed
+size_t allocations = 0;
+} // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  std::free(memory);
+}
+
+namespace {
+// Sizes count 32-bit limbs, as they did before big_integer moved to 64-bit ones, so results stay comparable
+constexpr int LIMB_BITS = 32;
+constexpr int64_t MIN_LIMBS = 1 << 10;
+constexpr int64_t MAX_LIMBS = 1 << 20;
+constexpr int64_t MIN_DIV_LIMBS = 1 << 6;
+constexpr int64_t MAX_DIV_LIMBS = 100000;
+constexpr int64_t MIN_DIGITS = 10000;
+constexpr int64_t MAX_DIGITS = 1000000;
+constexpr int BITWISE_BITS = 1 << 20;
+
+// Random number of `limbs` 32-bit limbs, built by halves so that building it takes O(n log n)
+big_integer random_big(size_t limbs, std::mt19937& rng) {
+  if (limbs == 1) {
+    return big_integer(static_cast<uint32_t>(rng()));
+  }
+  size_t low = limbs / 2;
+  return (random_big(limbs - low, rng) << static_cast<int>(low * LIMB_BITS)) + random_big(low, rng);
+}
+
+void bm_mul(benchmark::State& state) {
+  std::mt19937 rng(42);
+  big_integer a = random_big(state.range(0), rng);
+  big_integer b = random_big(state.range(0), rng);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a * b);
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+void bm_mul_gmp(benchmark::State& state) {
+  std::mt19937 rng(42);
+  big_integer_gmp a, b;
+  a.random(state.range(0) * LIMB_BITS - 1, rng);
+  b.random(state.range(0) * LIMB_BITS - 1, rng);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a * b);
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+// A number of 2n limbs divided by one of n limbs, quotient or remainder
+template <typename T, bool Remainder>
+void bm_div_impl(benchmark::State& state, const T& a, const T& b) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Remainder ? a % b : a / b);
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+template <bool Remainder>
+void bm_div(benchmark::State& state) {
+  std::mt19937 rng(42);
+  bm_div_impl<big_integer, Remainder>(state, random_big(2 * state.range(0), rng), random_big(state.range(0), rng));
+}
+
+template <bool Remainder>
+void bm_div_gmp(benchmark::State& state) {
+  std::mt19937 rng(42);
+  big_integer_gmp a, b;
+  a.random(2 * state.range(0) * LIMB_BITS - 1, rng);
+  b.random(state.range(0) * LIMB_BITS - 1, rng);
+  bm_div_impl<big_integer_gmp, Remainder>(state, a, b);
+}
+
+// Arithmetic on values of at most 64 bits and results of at most 128 bits, the allocations per iteration are reported
+void bm_small_mixed(benchmark::State& state) {
+  constexpr size_t COUNT = 1024;
+  std::mt19937 rng(42);
+  std::vector<big_integer> values;
+  for (size_t index = 0; index != COUNT; ++index) {
+    big_integer value = random_big(1 + index % 2, rng);
+    values.push_back(index % 5 == 0 ? -value : value);
+  }
+  size_t before = allocations;
+  for (auto _ : state) {
+    big_integer sum = 0;
+    for (size_t index = 0; index + 3 < COUNT; ++index) {
+      big_integer x = values[index] * values[index + 1] + values[index + 2];
+      x %= values[index + 3];
+      x <<= 7;
+      x -= values[index];
+      big_integer y = x++;
+      sum += x < y ? y >> 5 : x ^ values[index + 1];
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations - before),
+                                                benchmark::Counter::kAvgIterations);
+}
+
+// Decimal string of `digits` random digits
+std::string random_digits(size_t digits, std::mt19937& rng) {
+  std::string result(digits, '0');
+  for (char& digit : result) {
+    digit = static_cast<char>('0' + rng() % 10);
+  }
+  result[0] = '1';
+  return result;
+}
+
+template <typename T>
+void bm_from_string(benchmark::State& state) {
+  std::mt19937 rng(42);
+  std::string digits = random_digits(state.range(0), rng);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(T(digits));
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+template <typename T>
+void bm_to_string(benchmark::State& state) {
+  std::mt19937 rng(42);
+  T a(random_digits(state.range(0), rng));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(to_string(a));
+  }
+  state.SetComplexityN(state.range(0));
+}
+
+// Operands of one million bits, the first range(0) of them negative, the second one a limb shorter
+template <typename T>
+std::pair<T, T> bitwise_operands(benchmark::State& state);
+
+template <>
+std::pair<big_integer, big_integer> bitwise_operands(benchmark::State& state) {
+  std::mt19937 rng(42);
+  big_integer a = random_big(BITWISE_BITS / LIMB_BITS, rng);
+  big_integer b = random_big(BITWISE_BITS / LIMB_BITS - 1, rng);
+  return {state.range(0) > 0 ? -a : a, state.range(0) > 1 ? -b : b};
+}
+
+template <>
+std::pair<big_integer_gmp, big_integer_gmp> bitwise_operands(benchmark::State& state) {
+  std::mt19937 rng(42);
+  big_integer_gmp a, b;
+  a.random(BITWISE_BITS - 1, rng);
+  b.random(BITWISE_BITS - LIMB_BITS - 1, rng);
+  a = a < 0 ? -a : a;
+  b = b < 0 ? -b : b;
+  return {state.range(0) > 0 ? -a : a, state.range(0) > 1 ? -b : b};
+}
+
+template <typename T, typename Op>
+void bm_bitwise(benchmark::State& state) {
+  auto [a, b] = bitwise_operands<T>(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Op()(a, b));
+  }
+}
+
+// A shift by range(1) bits, of a negative operand if range(0) is set
+template <typename T, bool Right>
+void bm_shift(benchmark::State& state) {
+  T a = bitwise_operands<T>(state).first;
+  int shift = static_cast<int>(state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Right ? a >> shift : a << shift);
+  }
+}
+} // namespace
+
+BENCHMARK(bm_small_mixed)->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_mul)
+    ->ArgName("limbs")
+    ->RangeMultiplier(4)
+    ->Range(MIN_LIMBS, MAX_LIMBS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_mul_gmp)
+    ->ArgName("limbs")
+    ->RangeMultiplier(4)
+    ->Range(MIN_LIMBS, MAX_LIMBS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+BENCHMARK(bm_div<false>)
+    ->Name("bm_div")
+    ->ArgName("limbs")
+    ->RangeMultiplier(4)
+    ->Range(MIN_DIV_LIMBS, MAX_DIV_LIMBS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_div_gmp<false>)
+    ->Name("bm_div_gmp")
+    ->ArgName("limbs")
+    ->RangeMultiplier(4)
+    ->Range(MIN_DIV_LIMBS, MAX_DIV_LIMBS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_div<true>)
+    ->Name("bm_mod")
+    ->ArgName("limbs")
+    ->RangeMultiplier(4)
+    ->Range(MIN_DIV_LIMBS, MAX_DIV_LIMBS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_div_gmp<true>)
+    ->Name("bm_mod_gmp")
+    ->ArgName("limbs")
+    ->RangeMultiplier(4)
+    ->Range(MIN_DIV_LIMBS, MAX_DIV_LIMBS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+BENCHMARK(bm_from_string<big_integer>)
+    ->Name("bm_from_string")
+    ->ArgName("digits")
+    ->RangeMultiplier(10)
+    ->Range(MIN_DIGITS, MAX_DIGITS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_from_string<big_integer_gmp>)
+    ->Name("bm_from_string_gmp")
+    ->ArgName("digits")
+    ->RangeMultiplier(10)
+    ->Range(MIN_DIGITS, MAX_DIGITS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_to_string<big_integer>)
+    ->Name("bm_to_string")
+    ->ArgName("digits")
+    ->RangeMultiplier(10)
+    ->Range(MIN_DIGITS, MAX_DIGITS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+BENCHMARK(bm_to_string<big_integer_gmp>)
+    ->Name("bm_to_string_gmp")
+    ->ArgName("digits")
+    ->RangeMultiplier(10)
+    ->Range(MIN_DIGITS, MAX_DIGITS)
+    ->Unit(benchmark::kMillisecond)
+    ->Complexity();
+
+BENCHMARK(bm_bitwise<big_integer, std::bit_and<>>)->Name("bm_and")->ArgName("negative")->DenseRange(0, 2);
+BENCHMARK(bm_bitwise<big_integer_gmp, std::bit_and<>>)->Name("bm_and_gmp")->ArgName("negative")->DenseRange(0, 2);
+BENCHMARK(bm_bitwise<big_integer, std::bit_or<>>)->Name("bm_or")->ArgName("negative")->DenseRange(0, 2);
+BENCHMARK(bm_bitwise<big_integer_gmp, std::bit_or<>>)->Name("bm_or_gmp")->ArgName("negative")->DenseRange(0, 2);
+BENCHMARK(bm_bitwise<big_integer, std::bit_xor<>>)->Name("bm_xor")->ArgName("negative")->DenseRange(0, 2);
+BENCHMARK(bm_bitwise<big_integer_gmp, std::bit_xor<>>)->Name("bm_xor_gmp")->ArgName("negative")->DenseRange(0, 2);
+BENCHMARK(bm_shift<big_integer, false>)
+    ->Name("bm_shl")
+    ->ArgNames({"negative", "shift"})
+    ->ArgsProduct({{0}, {64, 12345}});
+BENCHMARK(bm_shift<big_integer_gmp, false>)
+    ->Name("bm_shl_gmp")
+    ->ArgNames({"negative", "shift"})
+    ->ArgsProduct({{0}, {64, 12345}});
+BENCHMARK(bm_shift<big_integer, true>)
+    ->Name("bm_shr")
+    ->ArgNames({"negative", "shift"})
+    ->ArgsProduct({{0, 1}, {64, 12345}});
+BENCHMARK(bm_shift<big_integer_gmp, true>)
+    ->Name("bm_shr_gmp")
+    ->ArgNames({"negative", "shift"})
+    ->ArgsProduct({{0, 1}, {64, 12345}});
+
+BENCHMARK_MAIN();
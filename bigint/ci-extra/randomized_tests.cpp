@@ -7,6 +7,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -180,6 +181,83 @@ TEST(correctness_random, mul) {
   }
 }
 
+TEST(correctness_random, mul_large) {
+  // sizes from the schoolbook to the Toom-3 range, balanced and not
+  std::default_random_engine rng(19);
+  for (size_t a_size : {1000, 6000, 20000, 50000}) {
+    for (size_t b_size : {700, 5000, 19000, 48000}) {
+      big_integer_gmp a, b;
+      a.random(a_size, rng);
+      b.random(b_size, rng);
+      big_integer_gmp c = a * b;
+      big_integer R = big_integer(to_string(a)) * big_integer(to_string(b));
+      EXPECT_EQ(to_string(c), to_string(R));
+    }
+  }
+}
+
+namespace {
+// Copy of a number of at most `bits` bits, assembled by halves with shifts and additions, so that operands too
+// long for the quadratic decimal conversion can be compared with GMP
+big_integer from_gmp(const big_integer_gmp& a, size_t bits) {
+  if (a < 0) {
+    return -from_gmp(-a, bits);
+  }
+  if (bits <= 64) {
+    return big_integer(std::stoull(to_string(a)));
+  }
+  int low_bits = static_cast<int>((bits + 127) / 128 * 64);
+  big_integer_gmp low_mask = (big_integer_gmp(1) << low_bits) - 1;
+  return (from_gmp(a >> low_bits, bits - low_bits) << low_bits) + from_gmp(a & low_mask, low_bits);
+}
+} // namespace
+
+TEST(correctness_random, mul_ntt) {
+  // both operands in the number-theoretic transform range, balanced, not and squared
+  std::default_random_engine rng(20);
+  for (size_t a_size : {1030000, 1600000}) {
+    for (size_t b_size : {1025000}) {
+      big_integer_gmp a, b;
+      a.random(a_size, rng);
+      b.random(b_size, rng);
+      big_integer_gmp c = a * b;
+      big_integer R = from_gmp(a, a_size + 1) * from_gmp(b, b_size + 1);
+      EXPECT_TRUE(R == from_gmp(c, a_size + b_size + 2));
+    }
+    big_integer_gmp a;
+    a.random(a_size, rng);
+    big_integer x = from_gmp(a, a_size + 1);
+    EXPECT_TRUE(x * x == from_gmp(a * a, 2 * a_size + 2));
+  }
+}
+
+TEST(correctness_random, string_conv_large) {
+  std::default_random_engine rng(22);
+  for (size_t size : {1000, 30000, 300000}) {
+    big_integer_gmp a;
+    a.random(size, rng);
+    std::string digits = to_string(a);
+    EXPECT_TRUE(big_integer(digits) == from_gmp(a, size + 1));
+    EXPECT_EQ(digits, to_string(from_gmp(a, size + 1)));
+  }
+}
+
+TEST(correctness_random, div_large) {
+  // divisors from the range of the schoolbook division to that of the recursive one, quotients short and long
+  std::default_random_engine rng(21);
+  for (size_t a_size : {3000, 40000, 150000}) {
+    for (size_t b_size : {1500, 12000, 30000, 90000}) {
+      big_integer_gmp a, b;
+      a.random(a_size, rng);
+      b.random(b_size, rng);
+      big_integer x = from_gmp(a, a_size + 1);
+      big_integer y = from_gmp(b, b_size + 1);
+      EXPECT_TRUE(x / y == from_gmp(a / b, a_size + 1));
+      EXPECT_TRUE(x % y == from_gmp(a % b, b_size + 1));
+    }
+  }
+}
+
 TEST(correctness_random, div) {
   std::default_random_engine rng(322);
   for (size_t itn = 0; itn != NUMBER_OF_ITERATIONS; ++itn) {
@@ -244,3 +322,41 @@ TEST(correctness_random, bit_shifts) {
     EXPECT_EQ(to_string(a >> shift), to_string(R >> shift));
   }
 }
+
+TEST(correctness_random, bitwise_large) {
+  // operands of different lengths and every sign, with zero low limbs that two's complement borrows through
+  std::default_random_engine rng(25);
+  for (size_t a_size : {5000, 60000}) {
+    for (size_t b_size : {3000, 90000}) {
+      big_integer_gmp a, b;
+      a.random(a_size, rng);
+      b.random(b_size, rng);
+      a <<= 100;
+      b <<= 64;
+      for (int signs = 0; signs != 4; ++signs) {
+        big_integer_gmp c = signs & 1 ? -a : a;
+        big_integer_gmp d = signs & 2 ? -b : b;
+        big_integer x = from_gmp(c, a_size + 101);
+        big_integer y = from_gmp(d, b_size + 65);
+        size_t bits = std::max(a_size + 101, b_size + 65);
+        EXPECT_TRUE((x & y) == from_gmp(c & d, bits));
+        EXPECT_TRUE((x | y) == from_gmp(c | d, bits));
+        EXPECT_TRUE((x ^ y) == from_gmp(c ^ d, bits));
+      }
+    }
+  }
+}
+
+TEST(correctness_random, bit_shifts_large) {
+  std::default_random_engine rng(26);
+  big_integer_gmp a;
+  a.random(30000, rng);
+  a <<= 96;
+  for (big_integer_gmp c : {a, -a, a + 1, -a - 1}) {
+    big_integer x = from_gmp(c, 30097);
+    for (int shift : {0, 1, 31, 32, 64, 95, 96, 97, 12345, 30096, 30097, 60000}) {
+      EXPECT_TRUE((x << shift) == from_gmp(c << shift, 30097 + shift));
+      EXPECT_TRUE((x >> shift) == from_gmp(c >> shift, 30097));
+    }
+  }
+}
@@ -6,8 +6,30 @@
 #include <chrono>
 #include <cstdlib>
 #include <limits>
+#include <new>
 #include <string>
 
+namespace {
+// Heap allocations made through operator new, see negation_long_shared
+size_t allocations = 0;
+} // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  std::free(memory);
+}
+
 namespace {
 
 class time_limit : public ::testing::Environment {
@@ -590,6 +612,19 @@ TEST(correctness, add_long_pow2) {
   EXPECT_EQ(a, c + b);
 }
 
+TEST(correctness, add_sub_self) {
+  big_integer a = 5;
+  a -= a;
+  EXPECT_EQ(a, 0);
+
+  big_integer b("-123456789012345678901234567890123456789");
+  big_integer c = b;
+  b += b;
+  EXPECT_EQ(b, c * 2);
+  b -= b;
+  EXPECT_EQ(b, 0);
+}
+
 TEST(correctness, sub_long) {
   big_integer a("10000000000000000000000000000000000000000000000000000000000000"
                 "000000000000000000000000000000");
@@ -792,3 +827,108 @@ TEST(correctness, converting_ctor4) {
 
   EXPECT_EQ(to_string(bignum), std::to_string(num));
 }
+
+namespace {
+// 2^bits - 1, all limbs set, so the products carry through every limb
+big_integer all_ones(int bits) {
+  return (big_integer(1) << bits) - 1;
+}
+} // namespace
+
+TEST(correctness, mul_long_all_ones) {
+  // (2^n - 1)(2^m - 1) = 2^(n + m) - 2^n - 2^m + 1, sizes around the thresholds of the split multiplications
+  for (int n : {39 * 64, 40 * 64, 41 * 64 + 5, 100 * 64, 299 * 64, 300 * 64 + 17, 700 * 64 + 3, 1300 * 64}) {
+    for (int m : {40 * 64, 77 * 64 + 9, 301 * 64, 680 * 64, 1300 * 64}) {
+      big_integer expected = (big_integer(1) << (n + m)) - (big_integer(1) << n) - (big_integer(1) << m) + 1;
+      EXPECT_EQ(expected, all_ones(n) * all_ones(m));
+      EXPECT_EQ(-expected, all_ones(n) * -all_ones(m));
+    }
+  }
+}
+
+TEST(correctness, mul_long_sparse) {
+  // factors with zero limbs in the middle and at the bottom of their halves
+  big_integer a = (big_integer(7) << (700 * 64)) + (big_integer(3) << (320 * 64)) + 1;
+  big_integer b = (big_integer(5) << (650 * 64)) + (big_integer(11) << (400 * 64));
+  big_integer expected = (big_integer(35) << (1350 * 64)) + (big_integer(77) << (1100 * 64)) +
+                         (big_integer(15) << (970 * 64)) + (big_integer(33) << (720 * 64)) +
+                         (big_integer(5) << (650 * 64)) + (big_integer(11) << (400 * 64));
+  EXPECT_EQ(expected, a * b);
+  EXPECT_EQ(expected, b * a);
+  EXPECT_EQ(0, a * big_integer());
+}
+
+TEST(correctness, mul_long_square) {
+  // (2^n + 1)^2 = 2^2n + 2^(n + 1) + 1 and (a + b)^2 = a^2 + 2ab + b^2
+  big_integer a = (big_integer(1) << 40000) + 1;
+  EXPECT_EQ((big_integer(1) << 80000) + (big_integer(1) << 40001) + 1, a * a);
+  big_integer b = all_ones(30000) * 12345 + 678;
+  EXPECT_EQ((a + b) * (a + b), a * a + 2 * a * b + b * b);
+}
+
+TEST(correctness, div_long_identity) {
+  // (x * y + r) / y = x with the largest remainder. Divisors with the top limb 2^63 or all limbs set make the
+  // quotient estimates go wrong; sizes are around the threshold of the recursive division.
+  for (int n : {64, 99 * 64, 100 * 64 + 7, 700 * 64 + 3}) {
+    big_integer x = all_ones(n) - (big_integer(1) << (n / 2));
+    for (int m : {65, 2 * 64, 23 * 64, 25 * 64, 100 * 64 + 1, 200 * 64}) {
+      for (const big_integer& y : {all_ones(m), (big_integer(1) << (m - 1)) + 1, all_ones(m) << 40}) {
+        big_integer a = x * y + (y - 1);
+        EXPECT_EQ(x, a / y);
+        EXPECT_EQ(y - 1, a % y);
+        EXPECT_EQ(-x, -a / y);
+        EXPECT_EQ(1 - y, -a % y);
+      }
+    }
+  }
+}
+
+TEST(correctness, string_conv_long) {
+  // powers of ten around the chunk and group boundaries of the decimal conversion, and zero chunks between digits
+  big_integer power = 1;
+  for (size_t zeros = 0; zeros != 700; ++zeros, power *= 10) {
+    std::string digits = "1" + std::string(zeros, '0');
+    EXPECT_EQ(power, big_integer(digits));
+    EXPECT_EQ(digits, to_string(power));
+  }
+  for (size_t zeros : {303, 304, 305, 608, 5000, 40000}) {
+    std::string digits = "7" + std::string(zeros, '0') + "123456789" + std::string(zeros, '0') + "5";
+    EXPECT_EQ(digits, to_string(big_integer(digits)));
+    EXPECT_EQ("-" + digits, to_string(big_integer("-000" + digits)));
+  }
+}
+
+TEST(correctness, copy_long_real_copy) {
+  // long values share their limbs until one of the copies is modified
+  big_integer a = all_ones(1000);
+  big_integer b = a;
+  big_integer c = b;
+  a += 1;
+  EXPECT_EQ(big_integer(1) << 1000, a);
+  EXPECT_EQ(all_ones(1000), b);
+  b >>= 990;
+  EXPECT_EQ(1023, b);
+  EXPECT_EQ(all_ones(1000), c);
+  big_integer d = c;
+  d = ~d;
+  --c;
+  EXPECT_EQ(-(big_integer(1) << 1000), d);
+  EXPECT_EQ(all_ones(1000) - 1, c);
+  EXPECT_EQ(all_ones(1000) - 1, big_integer(c) & c);
+}
+
+TEST(correctness, negation_long_shared) {
+  // negation flips the sign only, the limbs stay shared with the operand
+  big_integer a = all_ones(64000);
+  size_t before = allocations;
+  big_integer b = -a;
+  EXPECT_EQ(before, allocations);
+  EXPECT_EQ(0, a + b);
+}
+
+TEST(correctness, shl_shr_long_distance) {
+  // shifts by more than 2^16 limbs
+  big_integer a = (big_integer(1) << (70000 * 64 + 5)) + 3;
+  EXPECT_EQ(3, a - ((a >> (70000 * 64 + 5)) << (70000 * 64 + 5)));
+  EXPECT_EQ(1, a >> (70000 * 64 + 5));
+}
@@ -0,0 +1,264 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "huffman.h"
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <fstream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+// Synthetic corpora, selected by the first benchmark argument
+enum corpus_kind { uniform, text, skewed, single, empty };
+
+constexpr std::size_t MIN_SIZE = 1 << 10;
+constexpr std::size_t MAX_SIZE = 1 << 30;
+constexpr std::size_t SIZE_MULTIPLIER = 32;
+
+// Words drawn with falling probabilities, so letters and spaces are distributed roughly like in English prose
+constexpr std::array<const char*, 48> WORDS = {
+    "the", "of", "and", "to", "a", "in", "that", "is", "was", "he", "for", "it", "with", "as", "his", "on",
+    "be", "at", "by", "had", "not", "are", "but", "from", "or", "have", "an", "they", "which", "one", "you", "were",
+    "all", "we", "her", "she", "there", "would", "their", "will", "when", "who", "him", "been", "has", "more",
+    "winter", "night"};
+
+std::string make_corpus(int64_t kind, std::size_t size) {
+  std::mt19937_64 gen(42);
+  std::string data;
+  if (kind == empty) {
+    return data;
+  }
+  data.reserve(size + 16);
+  if (kind == uniform) {
+    while (data.size() < size) {
+      uint64_t word = gen();
+      data.append(reinterpret_cast<const char*>(&word), sizeof(word));
+    }
+  } else if (kind == text) {
+    std::geometric_distribution<std::size_t> word_dist(0.12);
+    std::size_t words = 0;
+    while (data.size() < size) {
+      data += WORDS[word_dist(gen) % WORDS.size()];
+      data += ++words % 12 == 0 ? ".\n" : " ";
+    }
+  } else if (kind == skewed) {
+    std::geometric_distribution<int> dist(0.05);
+    while (data.size() < size) {
+      data.push_back(static_cast<char>(dist(gen)));
+    }
+  } else {
+    data.assign(size, 'a');
+  }
+  data.resize(size);
+  return data;
+}
+
+// Discards the output, only its size is kept
+class count_sink : public std::streambuf {
+public:
+  std::size_t size() const {
+    return count;
+  }
+
+protected:
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    count += n;
+    return n;
+  }
+
+  int_type overflow(int_type c) override {
+    count++;
+    return traits_type::not_eof(c);
+  }
+
+private:
+  std::size_t count = 0;
+};
+
+// Appends the output to a string reserved in advance, so a 1 GiB stream isn't held twice while it grows
+class string_sink : public std::streambuf {
+public:
+  explicit string_sink(std::string& out) : out(out) {}
+
+protected:
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    out.append(s, n);
+    return n;
+  }
+
+  int_type overflow(int_type c) override {
+    out.push_back(traits_type::to_char_type(c));
+    return traits_type::not_eof(c);
+  }
+
+private:
+  std::string& out;
+};
+
+// Peak resident set size of the process in MiB, the input is included. Where the kernel allows, the peak is reset
+// before the timed loop of every benchmark, otherwise it is the peak of all benchmarks run so far.
+void reset_peak_rss() {
+  std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+double peak_rss_mib() {
+  std::ifstream status("/proc/self/status");
+  for (std::string line; std::getline(status, line);) {
+    if (line.rfind("VmHWM:", 0) == 0) {
+      return std::stod(line.substr(6)) / 1024;
+    }
+  }
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+  return static_cast<double>(usage.ru_maxrss) / (1 << 20);
+#else
+  return static_cast<double>(usage.ru_maxrss) / 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+void report(benchmark::State& state, std::size_t raw_size, std::size_t encoded_size) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw_size));
+  state.counters["ratio"] = raw_size != 0 ? static_cast<double>(encoded_size) / raw_size : 0;
+  state.counters["peak_rss_mib"] = peak_rss_mib();
+}
+
+void corpus_encode(benchmark::State& state, const huffman::encode_options& options) {
+  std::string data = make_corpus(state.range(0), state.range(1));
+  std::size_t encoded_size = 0;
+  reset_peak_rss();
+  for (auto _ : state) {
+    count_sink sink;
+    std::ostream out(&sink);
+    huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(data.data()), data.size(), out, options);
+    encoded_size = sink.size();
+  }
+  report(state, data.size(), encoded_size);
+}
+
+void corpus_decode(benchmark::State& state, const huffman::encode_options& options) {
+  std::string encoded;
+  std::size_t raw_size;
+  {
+    std::string data = make_corpus(state.range(0), state.range(1));
+    raw_size = data.size();
+    encoded.reserve(raw_size + raw_size / 8 + 4096);
+    string_sink sink(encoded);
+    std::ostream out(&sink);
+    huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(data.data()), data.size(), out, options);
+  }
+  reset_peak_rss();
+  for (auto _ : state) {
+    count_sink sink;
+    std::ostream out(&sink);
+    huffman::decode(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size(), out);
+    benchmark::DoNotOptimize(sink.size());
+  }
+  report(state, raw_size, encoded.size());
+}
+
+void bm_corpus_encode(benchmark::State& state) {
+  corpus_encode(state, {});
+}
+
+void bm_corpus_decode(benchmark::State& state) {
+  corpus_decode(state, {});
+}
+
+// Fills a buffer of the decoded size through an ostream, or with `direct` by decode_into
+void bm_corpus_decode_into(benchmark::State& state) {
+  std::string data = make_corpus(state.range(0), state.range(1));
+  std::string encoded;
+  {
+    string_sink sink(encoded);
+    std::ostream out(&sink);
+    huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(data.data()), data.size(), out);
+  }
+  // decode_into fills `direct`, which already has the decoded size; the sink appends to `buf` within its capacity
+  std::vector<huffman::atom_char_t> direct(data.size());
+  std::string buf;
+  buf.reserve(data.size());
+  const char* reserved = buf.data();
+  for (auto _ : state) {
+    if (state.range(2) != 0) {
+      benchmark::DoNotOptimize(huffman::decode_into(reinterpret_cast<const unsigned char*>(encoded.data()),
+                                                    encoded.size(), direct.data(), direct.size()));
+    } else {
+      buf.clear();
+      string_sink sink(buf);
+      std::ostream out(&sink);
+      huffman::decode(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size(), out);
+      benchmark::DoNotOptimize(buf.data());
+    }
+  }
+  if (state.range(2) == 0 && buf.data() != reserved) {
+    state.SkipWithError("the sink reallocated the buffer");
+  }
+  report(state, data.size(), encoded.size());
+}
+
+huffman::encode_options context_options() {
+  huffman::encode_options options;
+  options.context_model = true;
+  return options;
+}
+
+void bm_context_encode(benchmark::State& state) {
+  corpus_encode(state, context_options());
+}
+
+void bm_context_decode(benchmark::State& state) {
+  corpus_decode(state, context_options());
+}
+
+// Every corpus at 1 KiB, 32 KiB, 1 MiB, 32 MiB and 1 GiB, the empty one once
+void corpus_args(benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"corpus", "size"});
+  for (int64_t kind : {uniform, text, skewed, single}) {
+    for (std::size_t size = MIN_SIZE; size <= MAX_SIZE; size *= SIZE_MULTIPLIER) {
+      bench->Args({kind, static_cast<int64_t>(size)});
+    }
+  }
+  bench->Args({empty, 0});
+}
+
+// Every corpus at 1 MiB and 32 MiB, decoded through an ostream and directly
+void into_args(benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"corpus", "size", "direct"});
+  for (int64_t kind : {uniform, text, skewed, single}) {
+    for (int64_t size : {1 << 20, 32 << 20}) {
+      bench->Args({kind, size, 0});
+      bench->Args({kind, size, 1});
+    }
+  }
+}
+
+// The context model against the corpus benchmarks of the same text and skewed corpora
+void context_args(benchmark::internal::Benchmark* bench) {
+  bench->ArgNames({"corpus", "size"});
+  for (int64_t kind : {text, skewed}) {
+    bench->Args({kind, 1 << 20});
+    bench->Args({kind, 32 << 20});
+  }
+}
+} // namespace
+
+BENCHMARK(bm_corpus_encode)->Apply(corpus_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(bm_corpus_decode)->Apply(corpus_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(bm_corpus_decode_into)->Apply(into_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(bm_context_encode)->Apply(context_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(bm_context_decode)->Apply(context_args)->Unit(benchmark::kMillisecond);
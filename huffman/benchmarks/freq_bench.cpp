@@ -0,0 +1,66 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "huffman_freq/freq.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+constexpr std::size_t INPUT_SIZE = 1 << 20;
+
+// Distribution of the input bytes, selected by the benchmark argument
+enum input_kind { uniform, skewed, single };
+
+std::vector<huffman::atom_char_t> make_input(int64_t kind) {
+  std::mt19937 gen(42);
+  std::vector<huffman::atom_char_t> data(INPUT_SIZE);
+  if (kind == uniform) {
+    for (auto& c : data) {
+      c = static_cast<huffman::atom_char_t>(gen());
+    }
+  } else if (kind == skewed) {
+    // mostly lowercase ASCII, like text logs
+    std::geometric_distribution<int> dist(0.15);
+    for (auto& c : data) {
+      c = static_cast<huffman::atom_char_t>('a' + dist(gen) % 64);
+    }
+  } else {
+    std::fill(data.begin(), data.end(), 'a');
+  }
+  return data;
+}
+
+// The plain loop count_freq used before, one counter per byte value
+void count_freq_single_bank(const huffman::atom_char_t* data, std::size_t size, std::vector<huffman::int_freq_t>& freq) {
+  for (std::size_t i = 0; i != size; ++i) {
+    freq[data[i]]++;
+  }
+}
+
+void bm_freq_single_bank(benchmark::State& state) {
+  std::vector<huffman::atom_char_t> data = make_input(state.range(0));
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS);
+  for (auto _ : state) {
+    count_freq_single_bank(data.data(), data.size(), freq);
+    benchmark::DoNotOptimize(freq.data());
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+void bm_freq_banks(benchmark::State& state) {
+  std::vector<huffman::atom_char_t> data = make_input(state.range(0));
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS);
+  for (auto _ : state) {
+    huffman::count_freq(data.data(), data.size(), freq);
+    benchmark::DoNotOptimize(freq.data());
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+} // namespace
+
+BENCHMARK(bm_freq_single_bank)->ArgName("input")->DenseRange(uniform, single);
+BENCHMARK(bm_freq_banks)->ArgName("input")->DenseRange(uniform, single);
@@ -0,0 +1,99 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "binary_io/async_stream.h"
+#include "huffman.h"
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+constexpr std::size_t INPUT_SIZE = 32 << 20;
+// Bandwidth of the slow device in MiB/s, about the speed of the coder, so overlapping them halves the wall time
+constexpr std::size_t DEVICE_MIB_PER_SECOND = 200;
+
+// Stand-in for a spinning disk or a network file system: reads and writes wait as long as the transfer takes
+class slow_device : public std::streambuf {
+public:
+  explicit slow_device(std::string data = {}) : data(std::move(data)) {
+    setg(this->data.data(), this->data.data(), this->data.data() + this->data.size());
+  }
+
+protected:
+  std::streamsize xsgetn(char* s, std::streamsize n) override {
+    n = std::streambuf::xsgetn(s, n);
+    wait(n);
+    return n;
+  }
+
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    wait(n);
+    return n;
+  }
+
+  int_type overflow(int_type c) override {
+    return traits_type::not_eof(c);
+  }
+
+private:
+  static void wait(std::size_t size) {
+    std::this_thread::sleep_for(std::chrono::microseconds(size / DEVICE_MIB_PER_SECOND));
+  }
+
+  std::string data;
+};
+
+std::string make_input() {
+  std::mt19937 gen(42);
+  std::geometric_distribution<int> dist(0.05);
+  std::string data(INPUT_SIZE, '\0');
+  for (char& c : data) {
+    c = static_cast<char>(dist(gen));
+  }
+  return data;
+}
+
+std::string make_encoded(const std::string& data) {
+  std::ostringstream out;
+  huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(data.data()), data.size(), out);
+  return out.str();
+}
+
+// Codes from one slow device to another, with the tool's --async-io buffers when the argument is 1
+void run(benchmark::State& state, const std::string& input, bool encoding) {
+  for (auto _ : state) {
+    slow_device source(input);
+    slow_device sink;
+    std::istream in(&source);
+    std::ostream out(&sink);
+    if (state.range(0) != 0) {
+      huffman::async_istreambuf async_in(&source);
+      huffman::async_ostreambuf async_out(&sink);
+      in.rdbuf(&async_in);
+      out.rdbuf(&async_out);
+      encoding ? huffman::encode(in, out) : huffman::decode(in, out);
+      out.flush();
+    } else {
+      encoding ? huffman::encode(in, out) : huffman::decode(in, out);
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * INPUT_SIZE));
+}
+
+void bm_slow_device_encode(benchmark::State& state) {
+  run(state, make_input(), true);
+}
+
+void bm_slow_device_decode(benchmark::State& state) {
+  run(state, make_encoded(make_input()), false);
+}
+} // namespace
+
+BENCHMARK(bm_slow_device_encode)->ArgName("async")->DenseRange(0, 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(bm_slow_device_decode)->ArgName("async")->DenseRange(0, 1)->Unit(benchmark::kMillisecond)->UseRealTime();
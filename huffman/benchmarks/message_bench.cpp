@@ -0,0 +1,149 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "huffman.h"
+#include "huffman_context/context.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr std::size_t MESSAGE_SIZE = 1024;
+constexpr std::size_t MESSAGE_COUNT = 256;
+
+// Text-like messages drawn from one distribution, as in an RPC stream
+const std::vector<std::string>& messages() {
+  static const std::vector<std::string> data = [] {
+    std::mt19937 gen(42);
+    std::geometric_distribution<int> dist(0.15);
+    std::vector<std::string> result(MESSAGE_COUNT, std::string(MESSAGE_SIZE, '\0'));
+    for (std::string& message : result) {
+      for (char& c : message) {
+        c = static_cast<char>(' ' + dist(gen) % 95);
+      }
+    }
+    return result;
+  }();
+  return data;
+}
+
+std::shared_ptr<const huffman::shared_table> trained_table() {
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+  for (const std::string& message : messages()) {
+    for (char c : message) {
+      freq[static_cast<unsigned char>(c)]++;
+    }
+  }
+  return std::make_shared<const huffman::shared_table>(freq);
+}
+
+const huffman::atom_char_t* bytes(const std::string& data) {
+  return reinterpret_cast<const huffman::atom_char_t*>(data.data());
+}
+
+void bm_message_encode_stream(benchmark::State& state) {
+  std::size_t i = 0;
+  for (auto _ : state) {
+    std::istringstream in(messages()[i++ % MESSAGE_COUNT]);
+    std::ostringstream out;
+    huffman::encode(in, out);
+    benchmark::DoNotOptimize(out.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+}
+
+void bm_message_encode_context(benchmark::State& state) {
+  huffman::encoder encoder;
+  std::vector<unsigned char> out;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const std::string& message = messages()[i++ % MESSAGE_COUNT];
+    encoder.encode(bytes(message), message.size(), out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+}
+
+void bm_message_encode_shared(benchmark::State& state) {
+  huffman::encode_options options;
+  options.table = trained_table();
+  huffman::encoder encoder(options);
+  std::vector<unsigned char> out;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const std::string& message = messages()[i++ % MESSAGE_COUNT];
+    encoder.encode(bytes(message), message.size(), out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+}
+
+// Every message encoded by `encoder`
+std::vector<std::vector<unsigned char>> encode_all(huffman::encoder& encoder) {
+  std::vector<std::vector<unsigned char>> result(MESSAGE_COUNT);
+  for (std::size_t i = 0; i != MESSAGE_COUNT; ++i) {
+    encoder.encode(bytes(messages()[i]), MESSAGE_SIZE, result[i]);
+  }
+  return result;
+}
+
+void bm_message_decode_stream(benchmark::State& state) {
+  huffman::encoder encoder;
+  std::vector<std::string> encoded;
+  for (const auto& message : encode_all(encoder)) {
+    encoded.emplace_back(message.begin(), message.end());
+  }
+  std::size_t i = 0;
+  for (auto _ : state) {
+    std::istringstream in(encoded[i++ % MESSAGE_COUNT]);
+    std::ostringstream out;
+    huffman::decode(in, out);
+    benchmark::DoNotOptimize(out.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+}
+
+void bm_message_decode_context(benchmark::State& state) {
+  huffman::encoder encoder;
+  std::vector<std::vector<unsigned char>> encoded = encode_all(encoder);
+  huffman::decoder decoder;
+  std::vector<huffman::atom_char_t> out;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const auto& message = encoded[i++ % MESSAGE_COUNT];
+    decoder.decode(message.data(), message.size(), out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+}
+
+void bm_message_decode_shared(benchmark::State& state) {
+  huffman::encode_options options;
+  huffman::decode_options decode_options;
+  options.table = decode_options.table = trained_table();
+  huffman::encoder encoder(options);
+  std::vector<std::vector<unsigned char>> encoded = encode_all(encoder);
+  huffman::decoder decoder(decode_options);
+  std::vector<huffman::atom_char_t> out;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const auto& message = encoded[i++ % MESSAGE_COUNT];
+    decoder.decode(message.data(), message.size(), out);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * MESSAGE_SIZE);
+}
+} // namespace
+
+BENCHMARK(bm_message_encode_stream);
+BENCHMARK(bm_message_encode_context);
+BENCHMARK(bm_message_encode_shared);
+BENCHMARK(bm_message_decode_stream);
+BENCHMARK(bm_message_decode_context);
+BENCHMARK(bm_message_decode_shared);
@@ -0,0 +1,93 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "huffman.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+// Skewed bytes compress to about 60%, which keeps both the histogram and the bit packing busy
+std::string make_input(std::size_t size) {
+  std::mt19937 gen(42);
+  std::geometric_distribution<int> dist(0.05);
+  std::string data(size, '\0');
+  for (char& c : data) {
+    c = static_cast<char>(dist(gen));
+  }
+  return data;
+}
+
+const std::string& input() {
+  static const std::string data = make_input(64 << 20);
+  return data;
+}
+
+const std::string& encoded() {
+  static const std::string data = [] {
+    std::istringstream in(input());
+    std::ostringstream out;
+    huffman::encode(in, out);
+    return out.str();
+  }();
+  return data;
+}
+
+// The single-table format of files written before blocks, decoded from memory
+const std::string& encoded_single_table() {
+  static const std::string data = [] {
+    huffman::encode_options options;
+    options.block_size = 0;
+    std::ostringstream out;
+    huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(input().data()), input().size(), out, options);
+    return out.str();
+  }();
+  return data;
+}
+
+void bm_encode(benchmark::State& state) {
+  huffman::encode_options options;
+  options.threads = state.range(0);
+  const std::string& data = input();
+  for (auto _ : state) {
+    std::istringstream in(data);
+    std::ostringstream out;
+    huffman::encode(in, out, options);
+    benchmark::DoNotOptimize(out.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * input().size());
+}
+
+void bm_decode(benchmark::State& state) {
+  huffman::decode_options options;
+  options.threads = state.range(0);
+  const std::string& data = encoded();
+  for (auto _ : state) {
+    std::istringstream in(data);
+    std::ostringstream out;
+    huffman::decode(in, out, options);
+    benchmark::DoNotOptimize(out.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * input().size());
+}
+
+void bm_decode_single_table(benchmark::State& state) {
+  huffman::decode_options options;
+  options.threads = state.range(0);
+  const std::string& data = encoded_single_table();
+  for (auto _ : state) {
+    std::ostringstream out;
+    huffman::decode(reinterpret_cast<const unsigned char*>(data.data()), data.size(), out, options);
+    benchmark::DoNotOptimize(out.tellp());
+  }
+  state.SetBytesProcessed(state.iterations() * input().size());
+}
+} // namespace
+
+BENCHMARK(bm_encode)->RangeMultiplier(2)->Range(1, 16)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(bm_decode)->RangeMultiplier(2)->Range(1, 16)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(bm_decode_single_table)->RangeMultiplier(2)->Range(1, 16)->UseRealTime()->Unit(benchmark::kMillisecond);
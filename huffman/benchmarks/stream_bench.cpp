@@ -0,0 +1,94 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "binary_io/bit_writer.h"
+#include "huffman_convert_tree/convert_tree.h"
+#include "huffman_freq/freq.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+constexpr std::size_t INPUT_SIZE = 1 << 20;
+
+// Distribution of the input bytes, selected by the benchmark argument
+enum input_kind { uniform, skewed };
+
+std::vector<huffman::atom_char_t> make_input(int64_t kind) {
+  std::mt19937 gen(42);
+  std::vector<huffman::atom_char_t> data(INPUT_SIZE);
+  std::geometric_distribution<int> dist(0.15);
+  for (auto& c : data) {
+    c = static_cast<huffman::atom_char_t>(kind == uniform ? gen() : 'a' + dist(gen) % 64);
+  }
+  return data;
+}
+
+// One block coded with a single table, as one stream and as interleaved streams
+struct coded_block {
+  std::vector<huffman::atom_char_t> data;
+  std::vector<huffman::atom_char_t> code_len;
+  std::vector<unsigned char> payload;
+  std::vector<std::size_t> stream_end;
+};
+
+coded_block make_block(int64_t kind, std::size_t stream_count) {
+  coded_block block;
+  block.data = make_input(kind);
+  block.code_len.resize(huffman::NUMBER_ATOM_CHARS);
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS);
+  huffman::count_freq(block.data.data(), block.data.size(), freq);
+  huffman::encode_table table = huffman::convert_tree::get_encode_table(freq);
+  for (std::size_t el = 0; el != huffman::NUMBER_ATOM_CHARS; ++el) {
+    block.code_len[el] = table[el].len;
+  }
+  block.payload.resize(block.data.size() * huffman::MAX_ENCODE_CODE_LEN / huffman::ATOM_CHAR_SIZE + 16);
+  std::size_t segment = block.data.size() / stream_count;
+  unsigned char* stream = block.payload.data();
+  for (std::size_t k = 0; k != stream_count; ++k) {
+    huffman::bit_writer writer(stream);
+    for (std::size_t i = k * segment; i != (k + 1) * segment; ++i) {
+      writer.write(table[block.data[i]].code, table[block.data[i]].len);
+    }
+    stream = writer.flush();
+    block.stream_end.push_back((stream - block.payload.data()) * huffman::ATOM_CHAR_SIZE);
+  }
+  block.payload.resize(stream - block.payload.data());
+  return block;
+}
+
+void bm_decode_single_stream(benchmark::State& state) {
+  coded_block block = make_block(state.range(0), 1);
+  huffman::convert_tree tree(block.code_len);
+  std::vector<huffman::atom_char_t> out(block.data.size());
+  for (auto _ : state) {
+    std::size_t pos = 0;
+    tree.decode_unpadded(block.payload.data(), pos, block.stream_end[0], out.data(), out.data() + out.size());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * out.size());
+}
+
+void bm_decode_interleaved(benchmark::State& state) {
+  coded_block block = make_block(state.range(0), huffman::INTERLEAVED_STREAMS);
+  huffman::convert_tree tree(block.code_len);
+  std::vector<huffman::atom_char_t> out(block.data.size());
+  std::size_t segment = out.size() / huffman::INTERLEAVED_STREAMS;
+  for (auto _ : state) {
+    std::array<huffman::bit_stream, huffman::INTERLEAVED_STREAMS> streams{};
+    for (std::size_t k = 0; k != streams.size(); ++k) {
+      streams[k] = {k == 0 ? 0 : block.stream_end[k - 1], block.stream_end[k], out.data() + k * segment,
+                    out.data() + (k + 1) * segment};
+    }
+    tree.decode_interleaved(block.payload.data(), streams);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * out.size());
+}
+} // namespace
+
+BENCHMARK(bm_decode_single_stream)->ArgName("input")->DenseRange(uniform, skewed);
+BENCHMARK(bm_decode_interleaved)->ArgName("input")->DenseRange(uniform, skewed);
@@ -0,0 +1,126 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "huffman_convert_tree/convert_tree.h"
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+// Frequencies of one block, selected by the benchmark argument
+enum freq_kind { uniform, skewed, sparse };
+
+std::vector<huffman::int_freq_t> make_freq(int64_t kind) {
+  std::mt19937 gen(42);
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS);
+  if (kind == uniform) {
+    for (auto& el : freq) {
+      el = 4000 + gen() % 200;
+    }
+  } else if (kind == skewed) {
+    std::geometric_distribution<int> dist(0.05);
+    for (std::size_t i = 0; i != 1 << 20; ++i) {
+      freq[dist(gen) % huffman::NUMBER_ATOM_CHARS]++;
+    }
+  } else {
+    // a handful of symbols, like the groups of the context model
+    for (std::size_t el = 'a'; el <= 'z'; el += 3) {
+      freq[el] = 1 + gen() % 1000;
+    }
+  }
+  return freq;
+}
+
+// The pointer tree get_encode_table built before: a heap node per symbol, merged through a priority queue, and
+// the depths collected recursively into a set per length
+struct tree_node {
+  std::unique_ptr<tree_node> left;
+  std::unique_ptr<tree_node> right;
+  huffman::atom_char_t value = 0;
+};
+
+void collect_len(const tree_node& node, std::size_t len, std::vector<std::set<huffman::atom_char_t>>& len_code) {
+  if (node.left == nullptr) {
+    len_code[len].insert(node.value);
+    return;
+  }
+  collect_len(*node.left, len + 1, len_code);
+  collect_len(*node.right, len + 1, len_code);
+}
+
+std::vector<huffman::atom_char_t> pointer_tree_len(const std::vector<huffman::int_freq_t>& freq) {
+  using item = std::pair<huffman::int_freq_t, tree_node*>;
+  auto heavier = [](const item& a, const item& b) { return a.first > b.first; };
+  std::priority_queue<item, std::vector<item>, decltype(heavier)> queue(heavier);
+  for (std::size_t el = 0; el != freq.size(); ++el) {
+    if (freq[el] != 0) {
+      auto* leaf = new tree_node;
+      leaf->value = static_cast<huffman::atom_char_t>(el);
+      queue.emplace(freq[el], leaf);
+    }
+  }
+  while (queue.size() > 1) {
+    item a = queue.top();
+    queue.pop();
+    item b = queue.top();
+    queue.pop();
+    auto* parent = new tree_node;
+    parent->left.reset(a.second);
+    parent->right.reset(b.second);
+    queue.emplace(a.first + b.first, parent);
+  }
+  std::unique_ptr<tree_node> root(queue.top().second);
+  std::vector<std::set<huffman::atom_char_t>> len_code(huffman::NUMBER_ATOM_CHARS);
+  collect_len(*root, 0, len_code);
+  std::vector<huffman::atom_char_t> code_len(huffman::NUMBER_ATOM_CHARS);
+  for (std::size_t len = 0; len != len_code.size(); ++len) {
+    for (huffman::atom_char_t el : len_code[len]) {
+      code_len[el] = static_cast<huffman::atom_char_t>(len);
+    }
+  }
+  return code_len;
+}
+
+void bm_tree_pointer_nodes(benchmark::State& state) {
+  std::vector<huffman::int_freq_t> freq = make_freq(state.range(0));
+  for (auto _ : state) {
+    huffman::encode_table table = huffman::convert_tree::get_canonical_table(pointer_tree_len(freq));
+    benchmark::DoNotOptimize(table.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void bm_tree_encode_table(benchmark::State& state) {
+  std::vector<huffman::int_freq_t> freq = make_freq(state.range(0));
+  for (auto _ : state) {
+    huffman::encode_table table = huffman::convert_tree::get_encode_table(freq);
+    benchmark::DoNotOptimize(table.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Decode tables rebuilt into the memory of the previous block's, like block_decoder does
+void bm_tree_decode_table(benchmark::State& state) {
+  huffman::encode_table codes = huffman::convert_tree::get_encode_table(make_freq(state.range(0)));
+  std::vector<huffman::atom_char_t> code_len(huffman::NUMBER_ATOM_CHARS);
+  for (std::size_t el = 0; el != huffman::NUMBER_ATOM_CHARS; ++el) {
+    code_len[el] = codes[el].len;
+  }
+  huffman::convert_tree tree(code_len);
+  for (auto _ : state) {
+    tree.assign(code_len);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+} // namespace
+
+BENCHMARK(bm_tree_pointer_nodes)->ArgName("freq")->DenseRange(uniform, sparse)->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_tree_encode_table)->ArgName("freq")->DenseRange(uniform, sparse)->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_tree_decode_table)->ArgName("freq")->DenseRange(uniform, sparse)->Unit(benchmark::kMicrosecond);
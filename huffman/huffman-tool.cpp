@@ -2,28 +2,83 @@
 // Created by Tedes on 03.06.2023.
 //
 
+#include "binary_io/async_stream.h"
+#include "binary_io/mapped_file.h"
 #include "huffman.h"
+#include "huffman_freq/freq.h"
+#include "huffman_shared/shared_table.h"
 #include "utils/constants.h"
+#include "utils/stats.h"
 
 #include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <vector>
 
 static const std::map<std::string, size_t> flags_arg = {
-    {  "compress", 0},
-    {"decompress", 0},
-    {     "input", 1},
-    {    "output", 1},
-    {      "help", 0}
+    {     "compress", 0},
+    {   "decompress", 0},
+    {        "train", 0},
+    {"extract-range", 2},
+    {        "table", 1},
+    {"context-model", 0},
+    {     "async-io", 0},
+    {        "stats", 1},
+    {        "input", 1},
+    {       "output", 1},
+    {   "block-size", 1},
+    {      "threads", 1},
+    {         "help", 0}
 };
 
+static const std::string STD_STREAM = "-";
+static const size_t MAX_THREADS = 256;
+static const size_t OUT_BUF_SIZE = 1 << 20;
+
 static int handle_error(std::string message) {
   std::cerr << message << std::endl;
   return 1;
 }
 
+// Counts the bytes of the file or of all regular files under the directory
+static void count_sample_freq(const std::filesystem::path& sample, std::vector<huffman::int_freq_t>& freq) {
+  if (std::filesystem::is_directory(sample)) {
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(sample)) {
+      if (entry.is_regular_file()) {
+        count_sample_freq(entry.path(), freq);
+      }
+    }
+    return;
+  }
+  huffman::mapped_file file(sample.string());
+  huffman::count_freq(file.data(), file.size(), freq);
+}
+
+static int train(const std::string& sample, std::ostream& out) {
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+  try {
+    if (sample == STD_STREAM) {
+      std::vector<char> buf(huffman::BUF_SIZE);
+      while (std::size_t size = std::cin.rdbuf()->sgetn(buf.data(), buf.size())) {
+        huffman::count_freq(reinterpret_cast<huffman::atom_char_t*>(buf.data()), size, freq);
+      }
+    } else {
+      count_sample_freq(sample, freq);
+    }
+    huffman::shared_table(freq).save(out);
+    out.flush();
+    if (out.fail()) {
+      throw std::runtime_error("Writing error");
+    }
+  } catch (std::exception& error) {
+    return handle_error("Training failed: " + std::string(error.what()));
+  }
+  return 0;
+}
+
 int main(int argc, char** argv) {
   std::map<std::string, std::vector<std::string>> flags;
   for (size_t i = 1; i < argc; ++i) {
@@ -37,6 +92,9 @@ int main(int argc, char** argv) {
     }
     flags[flag] = {};
     for (size_t j = 0; j != flags_arg.at(flag); ++j) {
+      if (i + 1 == argc) {
+        return handle_error("Missing value of flag: " + flag);
+      }
       i++;
       flags[flag].emplace_back(argv[i]);
     }
@@ -48,8 +106,23 @@ int main(int argc, char** argv) {
               << "--help                more information\n"
               << "--compress            encode file\n"
               << "--decompress          decode file\n"
-              << "--input FILE_IN       input file\n"
-              << "--output FILE_OUT     output file\n";
+              << "--train               make a code table of the input file or directory of samples\n"
+              << "--extract-range OFF LEN\n"
+              << "                      decode LEN bytes from offset OFF, only the blocks holding them are decoded\n"
+              << "--input FILE_IN       input file, - for stdin\n"
+              << "--output FILE_OUT     output file, - for stdout\n"
+              << "--block-size SIZE     compress by independent blocks of SIZE bytes in a single pass\n"
+              << "                      (default " << huffman::BLOCK_SIZE << ", 0 for one table per file,\n"
+              << "                      the format of versions before blocks, needs a seekable input)\n"
+              << "--threads N           encode or decode blocks on N threads (default 1), files of one table\n"
+              << "                      are decoded in chunks on N threads unless --async-io streams them\n"
+              << "--table TABLE         compress or decompress with a table made by --train,\n"
+              << "                      blocks carry its id instead of their own code lengths\n"
+              << "--context-model       compress text better: code every byte with a table selected by the byte\n"
+              << "                      before it, compression gets slower\n"
+              << "--async-io            read ahead and write behind on separate threads while coding,\n"
+              << "                      for slow disks and network file systems\n"
+              << "--stats FORMAT        print the time and throughput of every stage to stderr, text or json\n";
     return 0;
   }
   if (flags.count("input") == 0) {
@@ -61,25 +134,151 @@ int main(int argc, char** argv) {
   // if (flags["input"] == flags["output"]) {
   //   return handle_error("Same input and output file");
   // }
-  if (flags.count("compress") == flags.count("decompress")) {
+  if (flags.count("compress") + flags.count("decompress") + flags.count("train") + flags.count("extract-range") != 1) {
     return handle_error("Specify working mode");
   }
-  std::ifstream fin(flags["input"].front(), std::ios::binary);
-  std::ofstream fout(flags["output"].front(), std::ios::binary);
-  if (fin.fail()) {
-    return handle_error("Input file open error: " + std::string(strerror(errno)));
+  huffman::encode_options options;
+  if (flags.count("block-size") == 1) {
+    try {
+      options.block_size = std::stoull(flags["block-size"].front());
+    } catch (std::logic_error&) {
+      return handle_error("Invalid block size: " + flags["block-size"].front());
+    }
   }
-  if (fout.fail()) {
-    return handle_error("Output file open error: " + std::string(strerror(errno)));
+  std::size_t range_offset = 0;
+  std::size_t range_length = 0;
+  if (flags.count("extract-range") == 1) {
+    try {
+      range_offset = std::stoull(flags["extract-range"][0]);
+      range_length = std::stoull(flags["extract-range"][1]);
+    } catch (std::logic_error&) {
+      return handle_error("Invalid range: " + flags["extract-range"][0] + " " + flags["extract-range"][1]);
+    }
   }
+  options.context_model = flags.count("context-model") == 1;
+  bool stats = flags.count("stats") == 1;
+  if (stats && flags["stats"].front() != "text" && flags["stats"].front() != "json") {
+    return handle_error("Invalid stats format: " + flags["stats"].front());
+  }
+  if (stats && !huffman::STATS_ENABLED) {
+    return handle_error("Stats are disabled in this build");
+  }
+  huffman::stats::enable(stats);
+  huffman::decode_options decode_options;
+  if (flags.count("threads") == 1) {
+    try {
+      options.threads = std::stoull(flags["threads"].front());
+    } catch (std::logic_error&) {
+      return handle_error("Invalid number of threads: " + flags["threads"].front());
+    }
+    if (options.threads == 0 || options.threads > MAX_THREADS) {
+      return handle_error("Invalid number of threads: " + flags["threads"].front());
+    }
+    decode_options.threads = options.threads;
+  }
+  if (flags.count("table") == 1) {
+    std::ifstream table_in(flags["table"].front(), std::ios::binary);
+    if (table_in.fail()) {
+      return handle_error("Table file open error: " + std::string(strerror(errno)));
+    }
+    try {
+      options.table = std::make_shared<const huffman::shared_table>(huffman::shared_table::load(table_in));
+    } catch (std::runtime_error& error) {
+      return handle_error(error.what());
+    }
+    decode_options.table = options.table;
+  }
+  std::ios::sync_with_stdio(false);
+  bool from_stream = flags["input"].front() == STD_STREAM;
+  std::optional<huffman::mapped_file> mapped;
+  std::ifstream fin;
+  std::vector<char> out_buf(OUT_BUF_SIZE);
+  std::ofstream fout;
+  std::ostream& out = flags["output"].front() == STD_STREAM ? std::cout : fout;
+  // samples of --train may be a directory, they are read by train
+  bool training = flags.count("train") == 1;
+  // reading ahead replaces the mapping, range extraction reads only the blocks it needs and doesn't read ahead
+  bool async_io = flags.count("async-io") == 1;
+  bool read_ahead = async_io && flags.count("extract-range") == 0;
+  bool regular_input = !training && !from_stream && huffman::mapped_file::is_regular(flags["input"].front());
+  if (regular_input) {
+    std::error_code error;
+    if (std::filesystem::equivalent(flags["input"].front(), flags["output"].front(), error)) {
+      // truncating the output would pull the input from under the coder
+      return handle_error("Same input and output file");
+    }
+  }
+  if (regular_input && !read_ahead) {
+    try {
+      mapped.emplace(flags["input"].front());
+    } catch (std::runtime_error& error) {
+      return handle_error(error.what());
+    }
+  } else if (!training && !from_stream) {
+    fin.open(flags["input"].front(), std::ios::binary);
+    if (fin.fail()) {
+      return handle_error("Input file open error: " + std::string(strerror(errno)));
+    }
+  }
+  std::istream& in = from_stream ? std::cin : fin;
+  // the single-table format reads the input twice
+  if (flags.count("compress") == 1 && options.block_size == 0 && !mapped &&
+      (from_stream || fin.rdbuf()->pubseekoff(0, std::ios::cur, std::ios::in) == std::streampos(-1))) {
+    return handle_error("Block size 0 needs a seekable input");
+  }
+  if (&out == &fout) {
+    // blocks are written whole, a large buffer batches the small writes of the single-table format
+    fout.rdbuf()->pubsetbuf(out_buf.data(), out_buf.size());
+    fout.open(flags["output"].front(), std::ios::binary);
+    if (fout.fail()) {
+      return handle_error("Output file open error: " + std::string(strerror(errno)));
+    }
+  }
+  if (training) {
+    return train(flags["input"].front(), out);
+  }
+  std::optional<huffman::async_istreambuf> async_in;
+  std::optional<huffman::async_ostreambuf> async_out;
+  std::istream piped_in(nullptr);
+  std::ostream piped_out(nullptr);
+  if (async_io) {
+    if (read_ahead) {
+      piped_in.rdbuf(&async_in.emplace(in.rdbuf()));
+    }
+    piped_out.rdbuf(&async_out.emplace(out.rdbuf()));
+  }
+  std::istream& coder_in = async_in ? piped_in : in;
+  std::ostream& coder_out = async_out ? piped_out : out;
   try {
     if (flags.count("compress") == 1) {
-      huffman::encode(fin, fout);
+      if (mapped) {
+        huffman::encode(mapped->data(), mapped->size(), coder_out, options);
+      } else {
+        huffman::encode(coder_in, coder_out, options);
+      }
+    } else if (flags.count("extract-range") == 1) {
+      if (mapped) {
+        huffman::decode_range(mapped->data(), mapped->size(), coder_out, range_offset, range_length,
+                              decode_options);
+      } else {
+        huffman::decode_range(in, coder_out, range_offset, range_length, decode_options);
+      }
     } else {
-      huffman::decode(fin, fout);
+      if (mapped) {
+        huffman::decode(mapped->data(), mapped->size(), coder_out, decode_options);
+      } else {
+        huffman::decode(coder_in, coder_out, decode_options);
+      }
+    }
+    coder_out.flush();
+    if (coder_out.fail() || out.fail()) {
+      throw std::runtime_error("Writing error");
     }
   } catch (std::runtime_error& error) {
     std::string mode = flags.count("compress") == 1 ? "Encoding" : "Decoding";
     return handle_error(mode + " failed: " + std::string(error.what()));
   }
+  if (stats) {
+    huffman::stats::write(std::cerr, huffman::stats::snapshot(), flags["stats"].front() == "json");
+  }
 }
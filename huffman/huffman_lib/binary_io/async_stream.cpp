@@ -0,0 +1,236 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "async_stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+namespace huffman {
+buffer_ring::buffer_ring(std::size_t count, std::size_t size)
+    : buffers(count, std::vector<char>(size)), sizes(count) {
+  if (count == 0 || size == 0) {
+    throw std::runtime_error("Invalid buffers");
+  }
+}
+
+char* buffer_ring::acquire() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [this] { return closed || pushed - popped != buffers.size(); });
+  return closed ? nullptr : buffers[pushed % buffers.size()].data();
+}
+
+void buffer_ring::push(std::size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    sizes[pushed % buffers.size()] = size;
+    pushed++;
+  }
+  cv.notify_all();
+}
+
+void buffer_ring::finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  cv.notify_all();
+}
+
+std::pair<char*, std::size_t> buffer_ring::front() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [this] { return closed || finished || pushed != popped; });
+  if (closed || pushed == popped) {
+    return {nullptr, 0};
+  }
+  return {buffers[popped % buffers.size()].data(), sizes[popped % buffers.size()]};
+}
+
+void buffer_ring::pop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    popped++;
+  }
+  cv.notify_all();
+}
+
+bool buffer_ring::drain() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [this] { return closed || pushed == popped; });
+  return pushed == popped;
+}
+
+void buffer_ring::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+  }
+  cv.notify_all();
+}
+
+void buffer_ring::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  pushed = popped = 0;
+  finished = closed = false;
+}
+
+std::size_t buffer_ring::buffer_size() const {
+  return buffers.front().size();
+}
+
+async_istreambuf::async_istreambuf(std::streambuf* source, std::size_t buffers, std::size_t buffer_size)
+    : source(source), ring(buffers, buffer_size) {
+  start();
+}
+
+async_istreambuf::~async_istreambuf() {
+  stop();
+}
+
+void async_istreambuf::start() {
+  reader = std::thread(&async_istreambuf::read_ahead, this);
+}
+
+void async_istreambuf::stop() {
+  ring.close();
+  reader.join();
+  ring.reset();
+  holding = false;
+  setg(nullptr, nullptr, nullptr);
+}
+
+void async_istreambuf::read_ahead() {
+  while (char* buf = ring.acquire()) {
+    std::size_t size = source->sgetn(buf, static_cast<std::streamsize>(ring.buffer_size()));
+    if (size == 0) {
+      break;
+    }
+    ring.push(size);
+  }
+  ring.finish();
+}
+
+async_istreambuf::int_type async_istreambuf::underflow() {
+  if (gptr() != egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+  if (holding) {
+    position += egptr() - eback();
+    ring.pop();
+  }
+  auto [buf, size] = ring.front();
+  holding = buf != nullptr;
+  setg(buf, buf, buf + size);
+  return holding ? traits_type::to_int_type(*buf) : traits_type::eof();
+}
+
+std::streamsize async_istreambuf::xsgetn(char* s, std::streamsize n) {
+  std::streamsize done = 0;
+  while (done != n && underflow() != traits_type::eof()) {
+    std::streamsize size = std::min<std::streamsize>(n - done, egptr() - gptr());
+    std::memcpy(s + done, gptr(), size);
+    gbump(static_cast<int>(size));
+    done += size;
+  }
+  return done;
+}
+
+std::streamsize async_istreambuf::showmanyc() {
+  return underflow() != traits_type::eof() ? egptr() - gptr() : -1;
+}
+
+async_istreambuf::pos_type async_istreambuf::seekoff(off_type off, std::ios_base::seekdir dir,
+                                                     std::ios_base::openmode which) {
+  if (dir == std::ios_base::cur) {
+    std::streamoff current = position + (gptr() - eback());
+    if (off == 0) {
+      return current;
+    }
+    return seekpos(current + off, which);
+  }
+  if (dir == std::ios_base::beg) {
+    return seekpos(off, which);
+  }
+  stop();
+  pos_type result = source->pubseekoff(off, dir, std::ios_base::in);
+  position = result != pos_type(off_type(-1)) ? std::streamoff(result) : 0;
+  start();
+  return result;
+}
+
+async_istreambuf::pos_type async_istreambuf::seekpos(pos_type pos, std::ios_base::openmode) {
+  stop();
+  pos_type result = source->pubseekpos(pos, std::ios_base::in);
+  position = result != pos_type(off_type(-1)) ? std::streamoff(result) : 0;
+  start();
+  return result;
+}
+
+async_ostreambuf::async_ostreambuf(std::streambuf* sink, std::size_t buffers, std::size_t buffer_size)
+    : sink(sink), ring(buffers, buffer_size), writer(&async_ostreambuf::write_behind, this) {
+  char* buf = ring.acquire();
+  setp(buf, buf + ring.buffer_size());
+}
+
+async_ostreambuf::~async_ostreambuf() {
+  sync();
+  ring.finish();
+  writer.join();
+}
+
+bool async_ostreambuf::hand_over() {
+  if (pptr() != pbase()) {
+    ring.push(pptr() - pbase());
+    char* buf = ring.acquire();
+    setp(buf, buf + ring.buffer_size());
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  return !failed;
+}
+
+void async_ostreambuf::write_behind() {
+  for (auto [buf, size] = ring.front(); buf != nullptr; std::tie(buf, size) = ring.front()) {
+    if (sink->sputn(buf, static_cast<std::streamsize>(size)) != static_cast<std::streamsize>(size)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      failed = true;
+    }
+    ring.pop();
+  }
+}
+
+async_ostreambuf::int_type async_ostreambuf::overflow(int_type c) {
+  if (!hand_over()) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+std::streamsize async_ostreambuf::xsputn(const char* s, std::streamsize n) {
+  std::streamsize done = 0;
+  while (done != n) {
+    if (pptr() == epptr() && !hand_over()) {
+      break;
+    }
+    std::streamsize size = std::min<std::streamsize>(n - done, epptr() - pptr());
+    std::memcpy(pptr(), s + done, size);
+    pbump(static_cast<int>(size));
+    done += size;
+  }
+  return done;
+}
+
+int async_ostreambuf::sync() {
+  if (!hand_over() || !ring.drain() || sink->pubsync() != 0) {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  return failed ? -1 : 0;
+}
+} // namespace huffman
@@ -0,0 +1,115 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_ASYNC_STREAM_H
+#define HUFFMAN_ASYNC_STREAM_H
+
+#include <condition_variable>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace huffman {
+constexpr std::size_t ASYNC_BUFFERS = 4;
+constexpr std::size_t ASYNC_BUFFER_SIZE = 1 << 20;
+
+// Fixed set of buffers passed from a producing thread to a consuming one in order. The producer waits while all
+// buffers are full, the consumer while all are empty, so at most one buffer of each side is in use at a time.
+class buffer_ring {
+public:
+  buffer_ring(std::size_t count, std::size_t size);
+
+  // Producer side: the next buffer to fill, nullptr once the ring is closed
+  char* acquire();
+  void push(std::size_t size);
+  // No more buffers follow the pushed ones
+  void finish();
+
+  // Consumer side: the next filled buffer and its size, nullptr after the last one or once the ring is closed
+  std::pair<char*, std::size_t> front();
+  void pop();
+  // Waits until the consumer has popped every pushed buffer, false if the ring was closed first
+  bool drain();
+
+  // Wakes both sides, acquire and front return nullptr from now on
+  void close();
+  // Empties the ring, both threads must be done with it
+  void reset();
+
+  std::size_t buffer_size() const;
+
+private:
+  std::vector<std::vector<char>> buffers;
+  std::vector<std::size_t> sizes;
+  std::size_t pushed = 0;
+  std::size_t popped = 0;
+  bool finished = false;
+  bool closed = false;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+// Reads the source on a separate thread ahead of the consumer, so waiting for the device overlaps with coding.
+// Seeking stops the thread, seeks the source and starts reading ahead from the new position.
+class async_istreambuf : public std::streambuf {
+public:
+  explicit async_istreambuf(std::streambuf* source, std::size_t buffers = ASYNC_BUFFERS,
+                            std::size_t buffer_size = ASYNC_BUFFER_SIZE);
+  async_istreambuf(const async_istreambuf&) = delete;
+  async_istreambuf& operator=(const async_istreambuf&) = delete;
+  ~async_istreambuf() override;
+
+protected:
+  int_type underflow() override;
+  std::streamsize xsgetn(char* s, std::streamsize n) override;
+  // Waits for the next buffer, so readsome doesn't take a slow device for the end of the input
+  std::streamsize showmanyc() override;
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+
+private:
+  void start();
+  void stop();
+  void read_ahead();
+
+  std::streambuf* source;
+  buffer_ring ring;
+  std::thread reader;
+  // whether the get area is a buffer of the ring and the input position of its first byte
+  bool holding = false;
+  std::streamoff position = 0;
+};
+
+// Writes to the sink on a separate thread, so coding continues while the device is busy. Writing errors of the
+// sink are reported by the following overflow or sync.
+class async_ostreambuf : public std::streambuf {
+public:
+  explicit async_ostreambuf(std::streambuf* sink, std::size_t buffers = ASYNC_BUFFERS,
+                            std::size_t buffer_size = ASYNC_BUFFER_SIZE);
+  async_ostreambuf(const async_ostreambuf&) = delete;
+  async_ostreambuf& operator=(const async_ostreambuf&) = delete;
+  // Writes the rest and flushes the sink, errors are lost: sync first to see them
+  ~async_ostreambuf() override;
+
+protected:
+  int_type overflow(int_type c) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+  // Waits until the sink has taken everything written so far and flushes it
+  int sync() override;
+
+private:
+  // Hands the put area over to the writer and takes the next free buffer
+  bool hand_over();
+  void write_behind();
+
+  std::streambuf* sink;
+  buffer_ring ring;
+  std::mutex mutex;
+  bool failed = false;
+  std::thread writer;
+};
+} // namespace huffman
+#endif // HUFFMAN_ASYNC_STREAM_H
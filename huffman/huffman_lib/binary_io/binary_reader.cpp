@@ -4,10 +4,14 @@
 
 #include "binary_reader.h"
 
+#include "../utils/stats.h"
+
 #include <algorithm>
 
 namespace huffman {
-binary_reader::binary_reader(std::istream& in) : stream_buf(in.rdbuf()), buf(BUF_SIZE, '0'), pos(0), buf_size(0) {
+binary_reader::binary_reader(std::istream& in)
+    : stream_buf(in.rdbuf()), buf(BUF_SIZE + BUF_PADDING, '0'), pos(0), buf_size(0), read_size(0), payload_end(0),
+      stream_end(false) {
   if (!in.good()) {
     throw std::runtime_error("Broken file");
   }
@@ -54,7 +58,60 @@ bool binary_reader::eof() {
 }
 
 void binary_reader::update_buf() {
+  stage_timer timer(stage::read);
   buf_size = stream_buf->sgetn(buf.data(), BUF_SIZE);
+  timer.add_bytes(buf_size);
+  count_io(buf_size, 0);
   pos = 0;
+  read_size += buf_size;
+  stream_end = buf_size < BUF_SIZE;
+}
+
+const unsigned char* binary_reader::bits() const {
+  return reinterpret_cast<const unsigned char*>(buf.data());
+}
+
+std::size_t binary_reader::bits_end() const {
+  return payload_end;
+}
+
+bool binary_reader::finished() const {
+  return stream_end;
+}
+
+std::size_t binary_reader::fill_bits(std::size_t bit_pos) {
+  std::size_t skip = std::min(bit_pos / ATOM_CHAR_SIZE, buf_size);
+  std::copy(buf.data() + skip, buf.data() + buf_size, buf.data());
+  buf_size -= skip;
+  if (!stream_end) {
+    std::size_t requested = BUF_SIZE - buf_size;
+    stage_timer timer(stage::read);
+    std::size_t read = stream_buf->sgetn(buf.data() + buf_size, requested);
+    timer.add_bytes(read);
+    count_io(read, 0);
+    buf_size += read;
+    read_size += read;
+    stream_end = read < requested;
+  }
+  update_payload_end();
+  return bit_pos - skip * ATOM_CHAR_SIZE;
+}
+
+void binary_reader::update_payload_end() {
+  // the last out char may be incomplete, it is followed by a byte with the number of its meaningful bits
+  constexpr std::size_t tail_size = OUT_CHAR_SIZE / ATOM_CHAR_SIZE + 1;
+  if (!stream_end) {
+    payload_end = buf_size > tail_size ? (buf_size - tail_size) * ATOM_CHAR_SIZE : 0;
+    return;
+  }
+  if (buf_size == 0 || (read_size - 1) % (OUT_CHAR_SIZE / ATOM_CHAR_SIZE) != 0) {
+    throw std::runtime_error("Broken file");
+  }
+  std::size_t tail_bits = static_cast<unsigned char>(buf[buf_size - 1]);
+  std::size_t padding = OUT_CHAR_SIZE - tail_bits;
+  if (tail_bits == 0 || tail_bits > OUT_CHAR_SIZE || (buf_size - 1) * ATOM_CHAR_SIZE < padding) {
+    throw std::runtime_error("Broken file");
+  }
+  payload_end = (buf_size - 1) * ATOM_CHAR_SIZE - padding;
 }
 } // namespace huffman
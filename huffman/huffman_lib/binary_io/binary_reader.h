@@ -22,14 +22,26 @@ public:
   bool eof();
   bool is_empty();
 
+  // Bit-level access for the table-driven decoder: bits() points at the buffered payload and bits_end()
+  // is the number of its leading bits that are known to be valid. fill_bits() drops the bytes before
+  // bit `bit_pos`, reads more of the stream and returns the new position of that bit.
+  const unsigned char* bits() const;
+  std::size_t bits_end() const;
+  bool finished() const;
+  std::size_t fill_bits(std::size_t bit_pos);
+
 private:
   void update_buf();
+  void update_payload_end();
 
 private:
   std::basic_streambuf<char>* stream_buf;
   std::string buf;
   size_t pos;
   size_t buf_size;
+  size_t read_size;
+  size_t payload_end;
+  bool stream_end;
 };
 } // namespace huffman
 #endif // HUFFMAN_BINARY_READER_H
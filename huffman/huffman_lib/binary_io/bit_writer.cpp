@@ -0,0 +1,25 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "bit_writer.h"
+
+namespace huffman {
+bit_writer::bit_writer(unsigned char* out) : out(out), acc(0), filled(0) {}
+
+unsigned char* bit_writer::flush() {
+  store_be64(out, acc);
+  out += (filled + ATOM_CHAR_SIZE - 1) / ATOM_CHAR_SIZE;
+  acc = 0;
+  filled = 0;
+  return out;
+}
+
+unsigned char* bit_writer::position() const {
+  return out;
+}
+
+void bit_writer::move_to(unsigned char* new_out) {
+  out = new_out;
+}
+} // namespace huffman
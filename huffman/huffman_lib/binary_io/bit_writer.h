@@ -0,0 +1,45 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_BIT_WRITER_H
+#define HUFFMAN_BIT_WRITER_H
+
+#include "../utils/bit_utils.h"
+#include "../utils/constants.h"
+
+namespace huffman {
+// Packs codes MSB first into a preallocated buffer through a 64-bit accumulator.
+// The buffer must have sizeof(out_char_t) spare bytes past the last written bit.
+class bit_writer {
+public:
+  explicit bit_writer(unsigned char* out);
+
+  void write(out_char_t code, std::size_t len);
+  unsigned char* flush();
+
+  // Bytes before position() are final, the bits written after them are still held by the writer.
+  // move_to() continues at `out`, so a fixed buffer can be emptied and reused.
+  unsigned char* position() const;
+  void move_to(unsigned char* out);
+
+private:
+  unsigned char* out;
+  out_char_t acc;
+  std::size_t filled;
+};
+
+inline void bit_writer::write(out_char_t code, std::size_t len) {
+  if (filled + len <= OUT_CHAR_SIZE) {
+    acc |= code << (OUT_CHAR_SIZE - filled - len);
+    filled += len;
+    return;
+  }
+  std::size_t overflow = filled + len - OUT_CHAR_SIZE;
+  store_be64(out, acc | code >> overflow);
+  out += sizeof(out_char_t);
+  acc = code << (OUT_CHAR_SIZE - overflow);
+  filled = overflow;
+}
+} // namespace huffman
+#endif // HUFFMAN_BIT_WRITER_H
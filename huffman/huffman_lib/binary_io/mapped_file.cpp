@@ -0,0 +1,80 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define HUFFMAN_USE_MMAP
+#endif
+
+namespace huffman {
+#ifdef HUFFMAN_USE_MMAP
+mapped_file::mapped_file(const std::string& path) : ptr(nullptr), length(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error("Input file open error: " + std::string(strerror(errno)));
+  }
+  struct stat info {};
+  if (fstat(fd, &info) == -1) {
+    int error = errno;
+    close(fd);
+    throw std::runtime_error("Input file open error: " + std::string(strerror(error)));
+  }
+  length = info.st_size;
+  if (length != 0) {
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      int error = errno;
+      close(fd);
+      throw std::runtime_error("Input file mapping error: " + std::string(strerror(error)));
+    }
+    // the coders walk the input front to back, so aggressive read-ahead pays off on cold caches
+    madvise(mapped, length, MADV_SEQUENTIAL);
+    ptr = static_cast<const atom_char_t*>(mapped);
+  }
+  close(fd);
+}
+
+mapped_file::~mapped_file() {
+  if (length != 0) {
+    munmap(const_cast<atom_char_t*>(ptr), length);
+  }
+}
+#else
+mapped_file::mapped_file(const std::string& path) : ptr(nullptr), length(0) {
+  std::ifstream in(path, std::ios::binary);
+  if (in.fail()) {
+    throw std::runtime_error("Input file open error: " + std::string(strerror(errno)));
+  }
+  fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  ptr = fallback.data();
+  length = fallback.size();
+}
+
+mapped_file::~mapped_file() = default;
+#endif
+
+const atom_char_t* mapped_file::data() const {
+  return ptr;
+}
+
+std::size_t mapped_file::size() const {
+  return length;
+}
+
+bool mapped_file::is_regular(const std::string& path) {
+  std::error_code error;
+  return std::filesystem::is_regular_file(path, error);
+}
+} // namespace huffman
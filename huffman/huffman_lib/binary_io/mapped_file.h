@@ -0,0 +1,35 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_MAPPED_FILE_H
+#define HUFFMAN_MAPPED_FILE_H
+
+#include "../utils/constants.h"
+
+#include <string>
+#include <vector>
+
+namespace huffman {
+// Read-only view of a whole regular file. The file is memory-mapped where the platform allows it,
+// otherwise it is read into memory.
+class mapped_file {
+public:
+  explicit mapped_file(const std::string& path);
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  ~mapped_file();
+
+  const atom_char_t* data() const;
+  std::size_t size() const;
+
+  // Whether `path` names a regular file, which can be mapped
+  static bool is_regular(const std::string& path);
+
+private:
+  const atom_char_t* ptr;
+  std::size_t length;
+  std::vector<atom_char_t> fallback;
+};
+} // namespace huffman
+#endif // HUFFMAN_MAPPED_FILE_H
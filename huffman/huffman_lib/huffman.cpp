@@ -5,132 +5,707 @@
 #include "huffman.h"
 
 #include "binary_io/binary_reader.h"
-#include "binary_io/binary_writer.h"
+#include "binary_io/bit_writer.h"
+#include "huffman_block/block_codec.h"
 #include "huffman_convert_tree/convert_tree.h"
+#include "huffman_freq/freq.h"
+#include "huffman_shared/shared_table.h"
+#include "utils/stats.h"
+#include "utils/thread_pool.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <future>
+#include <limits>
 
 namespace huffman {
+// Reads from the stream into `data`, the input of the coder
+std::size_t read_input(std::streambuf& in, void* data, std::size_t size) {
+  stage_timer timer(stage::read);
+  std::size_t read = in.sgetn(static_cast<char*>(data), static_cast<std::streamsize>(size));
+  timer.add_bytes(read);
+  count_io(read, 0);
+  return read;
+}
+
+// Reads the next block of a stream into `block`, see block_decoder::read
+bool read_block(std::streambuf& in, std::vector<unsigned char>& block) {
+  stage_timer timer(stage::read);
+  bool read = block_decoder::read(in, block);
+  timer.add_bytes(block.size());
+  count_io(block.size(), 0);
+  return read;
+}
+
+void write_output(std::ostream& out, const void* data, std::size_t size) {
+  stage_timer timer(stage::write, size);
+  count_io(0, size);
+  out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
 std::vector<int_freq_t> count_freq(std::istream& in) {
   std::vector<int_freq_t> freq(NUMBER_ATOM_CHARS, 0);
   std::array<unsigned char, BUF_SIZE> buf{};
-  size_t count_dif = 0;
   std::streamsize buf_size;
   do {
-    buf_size = in.readsome(reinterpret_cast<char*>(buf.data()), BUF_SIZE);
+    {
+      // the first of two passes, the input is counted by the second one
+      stage_timer timer(stage::read);
+      buf_size = in.readsome(reinterpret_cast<char*>(buf.data()), BUF_SIZE);
+      timer.add_bytes(buf_size);
+    }
     // if (in.fail()) {
     //   throw std::runtime_error("Reading failed");
     // }
-    for (size_t i = 0; i < buf_size; i++) {
-      freq[buf[i]]++;
-      if (freq[buf[i]] == 1) {
-        count_dif++;
+    count_freq(buf.data(), buf_size, freq);
+  } while (buf_size != 0);
+  complete_freq(freq);
+  return freq;
+}
+
+// Encodes the chunks returned by `read` with one table: code lengths, the payload as whole big-endian
+// out chars and the number of meaningful bits in the last of them
+template <typename read_t>
+void encode_single_table(const encode_table& table, read_t read, std::ostream& out) {
+  if (out.fail()) {
+    throw std::runtime_error("Writing error");
+  }
+  std::array<atom_char_t, NUMBER_ATOM_CHARS> code_len{};
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    code_len[el] = table[el].len;
+  }
+  write_output(out, code_len.data(), code_len.size());
+  std::vector<unsigned char> buf(BUF_SIZE * MAX_ENCODE_CODE_LEN / ATOM_CHAR_SIZE + 2 * sizeof(out_char_t));
+  bit_writer writer(buf.data());
+  std::size_t bits = 0;
+  const atom_char_t* data;
+  while (std::size_t size = read(data)) {
+    {
+      stage_timer timer(stage::encode, size);
+      std::size_t chunk_bits = bits;
+      for (std::size_t i = 0; i != size; ++i) {
+        writer.write(table[data[i]].code, table[data[i]].len);
+        bits += table[data[i]].len;
       }
+      count_symbols(size, bits - chunk_bits);
     }
-  } while (buf_size != 0);
-  for (size_t i = 0; count_dif <= 1; ++i) {
-    if (freq[i] == 0) {
-      freq[i]++;
-      count_dif++;
+    write_output(out, buf.data(), writer.position() - buf.data());
+    writer.move_to(buf.data());
+  }
+  unsigned char* last = writer.position();
+  if (writer.flush() != last) {
+    last += sizeof(out_char_t);
+  }
+  *last++ = bits % OUT_CHAR_SIZE != 0 ? bits % OUT_CHAR_SIZE : OUT_CHAR_SIZE;
+  write_output(out, buf.data(), last - buf.data());
+}
+
+void encode_single_table(std::istream& in, std::ostream& out) {
+  encode_table table = convert_tree::get_encode_table(count_freq(in));
+  // the input is read twice, a pipe can't be rewound for the second pass
+  in.seekg(0);
+  if (in.fail()) {
+    throw std::runtime_error("Input is not seekable");
+  }
+  auto stream_buf = in.rdbuf();
+  std::array<atom_char_t, BUF_SIZE> buf{};
+  encode_single_table(
+      table,
+      [stream_buf, &buf](const atom_char_t*& data) {
+        data = buf.data();
+        return read_input(*stream_buf, buf.data(), BUF_SIZE);
+      },
+      out);
+}
+
+void encode_single_table(const atom_char_t* data, std::size_t size, std::ostream& out) {
+  std::vector<int_freq_t> freq(NUMBER_ATOM_CHARS, 0);
+  count_freq(data, size, freq);
+  complete_freq(freq);
+  std::size_t pos = 0;
+  encode_single_table(
+      convert_tree::get_encode_table(freq),
+      [data, size, &pos](const atom_char_t*& chunk) {
+        chunk = data + pos;
+        std::size_t chunk_size = std::min(BUF_SIZE, size - pos);
+        pos += chunk_size;
+        return chunk_size;
+      },
+      out);
+}
+
+// Reads items into slots on the calling thread, processes them on the pool and writes the results in reading order.
+// Every thread has two slots, so reading and writing overlap with processing.
+template <typename slot_t, typename read_t, typename process_t, typename write_t>
+void process_in_order(std::size_t threads, read_t read, process_t process, write_t write) {
+  std::vector<slot_t> slots(2 * threads);
+  std::vector<std::future<void>> done(slots.size());
+  thread_pool pool(threads);
+  std::size_t submitted = 0;
+  std::size_t written = 0;
+  while (true) {
+    slot_t& slot = slots[submitted % slots.size()];
+    if (submitted - written == slots.size()) {
+      done[written % slots.size()].get();
+      write(slot);
+      written++;
+    }
+    if (!read(slot)) {
+      break;
     }
+    done[submitted % slots.size()] = pool.submit([&process, &slot] { process(slot); });
+    submitted++;
+  }
+  for (; written != submitted; ++written) {
+    done[written % slots.size()].get();
+    write(slots[written % slots.size()]);
   }
-  return freq;
 }
 
-void write_code_len(std::map<atom_char_t, out_element>& code_table, binary_writer& writer) {
-  for (size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
-    if (code_table.count(el) != 0) {
-      writer.write(static_cast<atom_char_t>(code_table[el][LEN_INDEX_OUT_EL]));
+struct encode_slot {
+  std::vector<atom_char_t> raw;
+  const atom_char_t* data = nullptr;
+  std::size_t size = 0;
+  std::vector<unsigned char> encoded;
+  block_encoder encoder;
+};
+
+// `read` fills the slot's data and size with the next block and returns false at the end of the input
+template <typename read_t>
+void encode_blocks(read_t read, std::ostream& out, const encode_options& options) {
+  if (out.fail()) {
+    throw std::runtime_error("Writing error");
+  }
+  write_output(out, BLOCK_MAGIC.data(), BLOCK_MAGIC.size());
+  const shared_table* table = options.table.get();
+  auto process = [table, context_model = options.context_model](encode_slot& slot) {
+    slot.encoded.clear();
+    if (table != nullptr) {
+      block_encoder::encode_shared(slot.data, slot.size, *table, slot.encoded);
     } else {
-      writer.write(static_cast<atom_char_t>(0));
+      slot.encoder.encode(slot.data, slot.size, slot.encoded, context_model);
     }
+  };
+  std::vector<index_entry> index;
+  index_entry next{0, BLOCK_MAGIC.size()};
+  auto write = [&out, &index, &next](encode_slot& slot) {
+    write_output(out, slot.encoded.data(), slot.encoded.size());
+    index.push_back(next);
+    next.raw_offset += slot.size;
+    next.encoded_offset += slot.encoded.size();
+  };
+  if (options.threads <= 1) {
+    encode_slot slot;
+    while (read(slot)) {
+      process(slot);
+      write(slot);
+    }
+  } else {
+    process_in_order<encode_slot>(options.threads, read, process, write);
+  }
+  std::vector<unsigned char> end;
+  block_encoder::finish(index, end);
+  write_output(out, end.data(), end.size());
+  if (out.fail()) {
+    throw std::runtime_error("Writing error");
   }
 }
 
-void encode(std::istream& in, std::ostream& out) {
-  std::map<atom_char_t, out_element> code_table = convert_tree::get_encode_code_table(count_freq(in));
-  in.seekg(0);
-  binary_writer writer(out);
-  write_code_len(code_table, writer);
+void check_options(const encode_options& options) {
+  if (options.block_size > MAX_BLOCK_SIZE) {
+    throw std::runtime_error("Block size is too big");
+  }
+  if (options.block_size == 0 && options.table) {
+    throw std::runtime_error("Shared table needs blocks");
+  }
+}
+
+void encode(std::istream& in, std::ostream& out, const encode_options& options) {
+  check_options(options);
+  if (options.block_size == 0) {
+    encode_single_table(in, out);
+    return;
+  }
   auto stream_buf = in.rdbuf();
-  std::array<unsigned char, BUF_SIZE> buf{};
-  for (std::streamsize buf_size = 1; buf_size != 0;) {
-    buf_size = stream_buf->sgetn(reinterpret_cast<char*>(buf.data()), BUF_SIZE);
-    for (size_t i = 0; i < buf_size; i++) {
-      writer.write_out(code_table[buf[i]]);
-    }
+  encode_blocks(
+      [stream_buf, block_size = options.block_size](encode_slot& slot) {
+        // the buffer grows with the input, so short streams don't pay for a whole block
+        slot.size = 0;
+        while (slot.size != block_size) {
+          if (slot.size == slot.raw.size()) {
+            slot.raw.resize(std::min(block_size, std::max(BUF_SIZE, 2 * slot.raw.size())));
+          }
+          std::size_t read = read_input(*stream_buf, slot.raw.data() + slot.size, slot.raw.size() - slot.size);
+          if (read == 0) {
+            break;
+          }
+          slot.size += read;
+        }
+        slot.data = slot.raw.data();
+        return slot.size != 0;
+      },
+      out, options);
+}
+
+void encode(const atom_char_t* data, std::size_t size, std::ostream& out, const encode_options& options) {
+  check_options(options);
+  count_io(size, 0);
+  if (options.block_size == 0) {
+    encode_single_table(data, size, out);
+    return;
   }
+  std::size_t pos = 0;
+  encode_blocks(
+      [data, size, &pos, block_size = options.block_size](encode_slot& slot) {
+        slot.data = data + pos;
+        slot.size = std::min(block_size, size - pos);
+        pos += slot.size;
+        return slot.size != 0;
+      },
+      out, options);
 }
 
 std::vector<atom_char_t> read_code_len(std::istream& in) {
   auto stream_buf = in.rdbuf();
   std::vector<atom_char_t> code_len(NUMBER_ATOM_CHARS, 0);
-  stream_buf->sgetn(reinterpret_cast<char*>(code_len.data()), NUMBER_ATOM_CHARS);
+  read_input(*stream_buf, code_len.data(), NUMBER_ATOM_CHARS);
   return code_len;
 }
 
-void merge_tail(tail_out& tail1, tail_out& tail2) {
-  if (tail2.second == 0) {
-    return;
-  }
-  if (tail1.second + tail2.second > OUT_CHAR_SIZE) {
-    tail1.first += tail2.first >> tail1.second;
-    tail2.first <<= OUT_CHAR_SIZE - tail1.second;
-    tail2.second = tail1.second + tail2.second - OUT_CHAR_SIZE;
-    tail1.second = OUT_CHAR_SIZE;
+struct decode_slot {
+  std::vector<unsigned char> buf;
+  const unsigned char* encoded = nullptr;
+  std::size_t encoded_size = 0;
+  std::vector<atom_char_t> raw;
+  block_decoder decoder;
+};
+
+// `read` points the slot's encoded data at the next block and returns false at the end of the stream.
+// Block headers hold the encoded sizes, so blocks are split off the input without decoding them.
+template <typename read_t>
+void decode_blocks(read_t read, std::ostream& out, const decode_options& options) {
+  const shared_table* table = options.table.get();
+  auto process = [table](decode_slot& slot) {
+    slot.raw.clear();
+    slot.decoder.decode(slot.encoded, slot.encoded_size, slot.raw, table);
+  };
+  auto write = [&out](decode_slot& slot) {
+    write_output(out, slot.raw.data(), slot.raw.size());
+  };
+  if (options.threads <= 1) {
+    decode_slot slot;
+    while (read(slot)) {
+      process(slot);
+      write(slot);
+    }
   } else {
-    tail1.first += tail2.first >> tail1.second;
-    tail1.second += tail2.second;
-    tail2 = {0, 0};
-  }
-}
-
-void merge_out_el(out_element& out_el1, out_element& out_el2) {
-  size_t i = 0;
-  tail_out tail1, tail2;
-  std::size_t old_size_out_el2 = out_el2[LEN_INDEX_OUT_EL];
-  while (out_el2[LEN_INDEX_OUT_EL] != 0 && out_el1[LEN_INDEX_OUT_EL] != NUMBER_ATOM_CHARS) {
-    tail1 = {out_el1[out_el1[LEN_INDEX_OUT_EL] / OUT_CHAR_SIZE], out_el1[LEN_INDEX_OUT_EL] % OUT_CHAR_SIZE};
-    tail2 = {out_el2[i], (out_el2[LEN_INDEX_OUT_EL] > OUT_CHAR_SIZE ? OUT_CHAR_SIZE : out_el2[LEN_INDEX_OUT_EL])};
-    std::size_t old_size_tail1 = tail1.second;
-    merge_tail(tail1, tail2);
-    out_el1[out_el1[LEN_INDEX_OUT_EL] / OUT_CHAR_SIZE] = tail1.first;
-    out_el2[i] = tail2.first;
-    out_el1[LEN_INDEX_OUT_EL] += tail1.second - old_size_tail1;
-    out_el2[LEN_INDEX_OUT_EL] += old_size_tail1 - tail1.second;
-    i++;
-  }
-  if (i == 0) {
-    return;
+    process_in_order<decode_slot>(options.threads, read, process, write);
   }
-  std::size_t shift = old_size_out_el2 - out_el2[LEN_INDEX_OUT_EL];
-  out_el2[i - 1] >>= shift % OUT_CHAR_SIZE;
-  out_el2[LEN_INDEX_OUT_EL] = old_size_out_el2;
-  shift_out_element(shift, out_el2);
 }
 
-void decode(std::istream& in, std::ostream& out) {
+void decode_blocks(std::istream& in, std::ostream& out, const decode_options& options) {
+  auto stream_buf = in.rdbuf();
+  std::array<unsigned char, BLOCK_MAGIC.size()> magic{};
+  read_input(*stream_buf, magic.data(), magic.size());
+  if (magic != BLOCK_MAGIC) {
+    throw std::runtime_error("Broken file");
+  }
+  decode_blocks(
+      [stream_buf](decode_slot& slot) {
+        if (!read_block(*stream_buf, slot.buf)) {
+          return false;
+        }
+        slot.encoded = slot.buf.data();
+        slot.encoded_size = slot.buf.size();
+        return true;
+      },
+      out, options);
+}
+
+void decode_blocks(const unsigned char* data, std::size_t size, std::ostream& out, const decode_options& options) {
+  if (size < BLOCK_MAGIC.size() || !std::equal(BLOCK_MAGIC.begin(), BLOCK_MAGIC.end(), data)) {
+    throw std::runtime_error("Broken file");
+  }
+  std::size_t pos = BLOCK_MAGIC.size();
+  decode_blocks(
+      [data, size, &pos](decode_slot& slot) {
+        slot.encoded = data + pos;
+        slot.encoded_size = block_decoder::block_size(slot.encoded, size - pos);
+        pos += slot.encoded_size;
+        return slot.encoded_size != 0;
+      },
+      out, options);
+}
+
+void decode_single_table(std::istream& in, std::ostream& out) {
   convert_tree convert_tree(read_code_len(in));
   binary_reader reader(in);
-  if (reader.is_empty()) {
+  std::vector<atom_char_t> buf(BUF_SIZE);
+  atom_char_t* buf_end = buf.data() + buf.size();
+  std::size_t pos = reader.fill_bits(0);
+  while (true) {
+    atom_char_t* last;
+    do {
+      {
+        stage_timer timer(stage::decode);
+        std::size_t start = pos;
+        last = convert_tree.decode(reader.bits(), pos, reader.bits_end(), buf.data(), buf_end);
+        timer.add_bytes(last - buf.data());
+        count_symbols(last - buf.data(), pos - start);
+      }
+      write_output(out, buf.data(), last - buf.data());
+    } while (last == buf_end);
+    if (reader.finished()) {
+      break;
+    }
+    pos = reader.fill_bits(pos);
+  }
+  if (pos != reader.bits_end()) {
+    throw std::runtime_error("Broken file");
+  }
+}
+
+// Appends the symbols of bits [pos, chunk_end) to `raw` and one more if the last of them stops before chunk_end,
+// so `pos` ends on the first code boundary at or past chunk_end. Returns false if the payload ends before it.
+bool decode_chunk(const convert_tree& tree, const unsigned char* payload, std::size_t& pos, std::size_t chunk_end,
+                  std::size_t end, std::vector<atom_char_t>& raw) {
+  bool full;
+  do {
+    std::size_t size = raw.size();
+    raw.resize(size + BUF_SIZE);
+    atom_char_t* last = tree.decode_unpadded(payload, pos, chunk_end, raw.data() + size, raw.data() + raw.size());
+    full = last == raw.data() + raw.size();
+    raw.resize(last - raw.data());
+  } while (full);
+  if (pos < chunk_end) {
+    atom_char_t value;
+    if (tree.decode_unpadded(payload, pos, end, &value, &value + 1) == &value) {
+      return false;
+    }
+    raw.push_back(value);
+  }
+  return true;
+}
+
+// A chunk of payload bits [begin, end) decoded from `begin` as if a code started there
+struct sync_slot {
+  std::size_t begin = 0;
+  std::size_t end = 0;
+  std::vector<atom_char_t> raw;
+  // bit positions of the first SYNC_SYMBOLS symbols of raw
+  std::vector<std::size_t> starts;
+  // first code boundary at or past end, or where the payload ran out
+  std::size_t stop = 0;
+};
+
+// Decodes the chunks on the pool and joins them in order. A chunk decoded from a wrong boundary goes astray until
+// one of its codes ends where a true code ends, from then on both decodings are the same. The writer decodes from
+// where the previous chunk stopped until it meets one of the recorded starts and takes the rest of the chunk as it is.
+void decode_sync_chunks(const convert_tree& tree, const unsigned char* payload, std::size_t end, std::ostream& out,
+                        std::size_t threads) {
+  constexpr std::size_t chunk_bits = SYNC_CHUNK_SIZE * ATOM_CHAR_SIZE;
+  std::size_t next_begin = 0;
+  auto read = [&next_begin, end](sync_slot& slot) {
+    slot.begin = next_begin;
+    slot.end = std::min(end, next_begin + chunk_bits);
+    next_begin = slot.end;
+    return slot.begin != end;
+  };
+  auto process = [&tree, payload, end](sync_slot& slot) {
+    stage_timer timer(stage::decode);
+    slot.raw.clear();
+    slot.starts.clear();
+    std::size_t pos = slot.begin;
+    bool valid = true;
+    while (valid && slot.starts.size() != SYNC_SYMBOLS && pos < slot.end) {
+      slot.starts.push_back(pos);
+      atom_char_t value;
+      valid = tree.decode_unpadded(payload, pos, end, &value, &value + 1) != &value;
+      if (valid) {
+        slot.raw.push_back(value);
+      } else {
+        slot.starts.pop_back();
+      }
+    }
+    if (valid) {
+      decode_chunk(tree, payload, pos, slot.end, end, slot.raw);
+    }
+    slot.stop = pos;
+    timer.add_bytes(slot.raw.size());
+  };
+  std::size_t pos = 0;
+  std::vector<atom_char_t> prefix;
+  auto write = [&tree, payload, end, &out, &pos, &prefix](sync_slot& slot) {
+    std::size_t start = pos;
+    std::size_t symbols;
+    prefix.clear();
+    auto join = std::lower_bound(slot.starts.begin(), slot.starts.end(), pos);
+    while (pos < slot.end && join != slot.starts.end() && *join != pos) {
+      atom_char_t value;
+      if (tree.decode_unpadded(payload, pos, end, &value, &value + 1) == &value) {
+        throw std::runtime_error("Broken file");
+      }
+      prefix.push_back(value);
+      join = std::lower_bound(join, slot.starts.end(), pos);
+    }
+    write_output(out, prefix.data(), prefix.size());
+    if (pos < slot.end && join != slot.starts.end()) {
+      // joined at a recorded start, the rest of the chunk is decoded right
+      std::size_t skip = join - slot.starts.begin();
+      write_output(out, slot.raw.data() + skip, slot.raw.size() - skip);
+      symbols = prefix.size() + slot.raw.size() - skip;
+      pos = slot.stop;
+    } else {
+      // the decodings didn't meet among the recorded starts, the chunk is decoded again on this thread
+      slot.raw.clear();
+      if (pos < slot.end && !decode_chunk(tree, payload, pos, slot.end, end, slot.raw)) {
+        throw std::runtime_error("Broken file");
+      }
+      write_output(out, slot.raw.data(), slot.raw.size());
+      symbols = prefix.size() + slot.raw.size();
+    }
+    if (pos < slot.end) {
+      throw std::runtime_error("Broken file");
+    }
+    count_symbols(symbols, pos - start);
+  };
+  process_in_order<sync_slot>(threads, read, process, write);
+  if (pos != end) {
+    throw std::runtime_error("Broken file");
+  }
+}
+
+// Returns the number of payload bits of the single-table format in memory
+std::size_t single_table_end(const unsigned char* data, std::size_t size) {
+  // code lengths, whole out chars of payload and the number of meaningful bits in the last of them
+  if (size <= NUMBER_ATOM_CHARS || (size - NUMBER_ATOM_CHARS - 1) % sizeof(out_char_t) != 0) {
+    throw std::runtime_error("Broken file");
+  }
+  std::size_t payload_bits = (size - NUMBER_ATOM_CHARS - 1) * ATOM_CHAR_SIZE;
+  std::size_t tail_bits = data[size - 1];
+  std::size_t padding = OUT_CHAR_SIZE - tail_bits;
+  if (tail_bits == 0 || tail_bits > OUT_CHAR_SIZE || payload_bits < padding) {
+    throw std::runtime_error("Broken file");
+  }
+  return payload_bits - padding;
+}
+
+void decode_single_table(const unsigned char* data, std::size_t size, std::ostream& out, std::size_t threads) {
+  std::size_t end = single_table_end(data, size);
+  convert_tree convert_tree(std::vector<atom_char_t>(data, data + NUMBER_ATOM_CHARS));
+  if (threads > 1 && end > SYNC_CHUNK_SIZE * ATOM_CHAR_SIZE) {
+    decode_sync_chunks(convert_tree, data + NUMBER_ATOM_CHARS, end, out, threads);
     return;
   }
-  std::string buf;
-  buf.reserve(BUF_SIZE);
-  std::size_t buf_ind = 0;
-  out_element out_el1 = {}, out_el2 = {};
-  while (!reader.eof() || out_el1[LEN_INDEX_OUT_EL] != 0) {
-    if (out_el1[LEN_INDEX_OUT_EL] != NUMBER_ATOM_CHARS && !reader.eof()) {
-      reader.read(out_el2);
-      merge_out_el(out_el1, out_el2);
+  std::vector<atom_char_t> buf(BUF_SIZE);
+  atom_char_t* buf_end = buf.data() + buf.size();
+  std::size_t pos = 0;
+  atom_char_t* last;
+  do {
+    {
+      stage_timer timer(stage::decode);
+      std::size_t start = pos;
+      last = convert_tree.decode_unpadded(data + NUMBER_ATOM_CHARS, pos, end, buf.data(), buf_end);
+      timer.add_bytes(last - buf.data());
+      count_symbols(last - buf.data(), pos - start);
     }
-    buf[buf_ind++] = convert_tree.decode(out_el1);
-    if (buf_ind == BUF_SIZE) {
-      out.write(buf.data(), BUF_SIZE);
-      buf_ind = 0;
+    write_output(out, buf.data(), last - buf.data());
+  } while (last == buf_end);
+  if (pos != end) {
+    throw std::runtime_error("Broken file");
+  }
+}
+
+void decode(std::istream& in, std::ostream& out, const decode_options& options) {
+  if (!in.good()) {
+    throw std::runtime_error("Broken file");
+  }
+  if (in.rdbuf()->sgetc() == BLOCK_MAGIC[0]) {
+    decode_blocks(in, out, options);
+  } else {
+    decode_single_table(in, out);
+  }
+}
+
+void decode(const unsigned char* data, std::size_t size, std::ostream& out, const decode_options& options) {
+  count_io(size, 0);
+  if (size != 0 && data[0] == BLOCK_MAGIC[0]) {
+    decode_blocks(data, size, out, options);
+  } else {
+    decode_single_table(data, size, out, options.threads);
+  }
+}
+
+// An encoded block of a stream in memory and the offset of its data
+struct block_span {
+  const unsigned char* encoded;
+  std::size_t encoded_size;
+  std::size_t raw_offset;
+};
+
+// Splits a block stream in memory at the block headers, `raw_size` is set to the size of the decoded data
+std::vector<block_span> split_blocks(const unsigned char* data, std::size_t size, std::size_t& raw_size) {
+  if (size < BLOCK_MAGIC.size() || !std::equal(BLOCK_MAGIC.begin(), BLOCK_MAGIC.end(), data)) {
+    throw std::runtime_error("Broken file");
+  }
+  std::vector<block_span> blocks;
+  raw_size = 0;
+  for (std::size_t pos = BLOCK_MAGIC.size();;) {
+    std::size_t encoded_size = block_decoder::block_size(data + pos, size - pos);
+    if (encoded_size == 0) {
+      return blocks;
     }
-    merge_out_el(out_el1, out_el2);
+    blocks.push_back({data + pos, encoded_size, raw_size});
+    raw_size += block_decoder::raw_size(data + pos);
+    pos += encoded_size;
+  }
+}
+
+std::size_t decoded_size(const unsigned char* data, std::size_t size) {
+  if (size == 0 || data[0] != BLOCK_MAGIC[0]) {
+    throw std::runtime_error("Decoded size needs a block stream");
+  }
+  std::size_t raw_size;
+  split_blocks(data, size, raw_size);
+  return raw_size;
+}
+
+// Blocks are handed out one by one to the threads, each of them reusing its decoder's tables
+void decode_blocks_into(const std::vector<block_span>& blocks, atom_char_t* out, const decode_options& options) {
+  const shared_table* table = options.table.get();
+  std::atomic<std::size_t> next{0};
+  auto decode = [&blocks, out, table, &next] {
+    block_decoder decoder;
+    try {
+      for (std::size_t i; (i = next++) < blocks.size();) {
+        decoder.decode(blocks[i].encoded, blocks[i].encoded_size, out + blocks[i].raw_offset, table);
+      }
+    } catch (...) {
+      // the other threads stop after their current blocks
+      next = blocks.size();
+      throw;
+    }
+  };
+  std::size_t threads = std::min(options.threads, blocks.size());
+  if (threads <= 1) {
+    decode();
+    return;
+  }
+  thread_pool pool(threads);
+  std::vector<std::future<void>> done;
+  for (std::size_t thread = 0; thread != threads; ++thread) {
+    done.push_back(pool.submit(decode));
+  }
+  for (std::future<void>& task : done) {
+    task.get();
+  }
+}
+
+std::size_t decode_into(const unsigned char* data, std::size_t size, atom_char_t* out, std::size_t capacity,
+                        const decode_options& options) {
+  count_io(size, 0);
+  std::size_t raw_size;
+  if (size != 0 && data[0] == BLOCK_MAGIC[0]) {
+    std::vector<block_span> blocks = split_blocks(data, size, raw_size);
+    if (raw_size > capacity) {
+      throw std::runtime_error("Output buffer too small");
+    }
+    decode_blocks_into(blocks, out, options);
+  } else {
+    std::size_t end = single_table_end(data, size);
+    convert_tree convert_tree(std::vector<atom_char_t>(data, data + NUMBER_ATOM_CHARS));
+    stage_timer timer(stage::decode);
+    std::size_t pos = 0;
+    raw_size = convert_tree.decode_unpadded(data + NUMBER_ATOM_CHARS, pos, end, out, out + capacity) - out;
+    timer.add_bytes(raw_size);
+    count_symbols(raw_size, pos);
+    if (pos != end) {
+      throw std::runtime_error(raw_size == capacity ? "Output buffer too small" : "Broken file");
+    }
+  }
+  count_io(0, raw_size);
+  return raw_size;
+}
+
+// Writes the part of the block starting at `raw_offset` that falls into [begin, end)
+void write_overlap(const std::vector<atom_char_t>& raw, std::size_t raw_offset, std::size_t begin, std::size_t end,
+                   std::ostream& out) {
+  std::size_t first = std::max(begin, raw_offset) - raw_offset;
+  std::size_t last = std::min(end, raw_offset + raw.size()) - raw_offset;
+  write_output(out, raw.data() + first, last - first);
+}
+
+std::size_t range_end(std::size_t offset, std::size_t length) {
+  return offset + std::min(length, std::numeric_limits<std::size_t>::max() - offset);
+}
+
+void decode_range(std::istream& in, std::ostream& out, std::size_t offset, std::size_t length,
+                  const decode_options& options) {
+  auto stream_buf = in.rdbuf();
+  std::array<unsigned char, BLOCK_MAGIC.size()> magic{};
+  if (read_input(*stream_buf, magic.data(), magic.size()) != magic.size() || magic != BLOCK_MAGIC) {
+    throw std::runtime_error("Range extraction needs a block stream");
+  }
+  std::size_t end = range_end(offset, length);
+  block_decoder decoder;
+  std::vector<unsigned char> block;
+  std::vector<atom_char_t> raw;
+  for (std::size_t raw_offset = 0; raw_offset < end && read_block(*stream_buf, block);) {
+    std::size_t raw_size = block_decoder::raw_size(block.data());
+    if (raw_offset + raw_size > offset) {
+      raw.clear();
+      decoder.decode(block.data(), block.size(), raw, options.table.get());
+      write_overlap(raw, raw_offset, offset, end, out);
+    }
+    raw_offset += raw_size;
+  }
+  if (out.fail()) {
+    throw std::runtime_error("Writing error");
+  }
+}
+
+void decode_range(const unsigned char* data, std::size_t size, std::ostream& out, std::size_t offset,
+                  std::size_t length, const decode_options& options) {
+  if (size < BLOCK_MAGIC.size() || !std::equal(BLOCK_MAGIC.begin(), BLOCK_MAGIC.end(), data)) {
+    throw std::runtime_error("Range extraction needs a block stream");
+  }
+  std::size_t end = range_end(offset, length);
+  // starts at the last block beginning at or before the offset, at the first block of streams without an index
+  std::vector<index_entry> index = block_decoder::read_index(data, size);
+  auto entry = std::upper_bound(index.begin(), index.end(), offset,
+                                [](std::size_t value, const index_entry& el) { return value < el.raw_offset; });
+  if (entry != index.begin()) {
+    --entry;
+  }
+  std::size_t pos = entry != index.end() ? entry->encoded_offset : BLOCK_MAGIC.size();
+  std::size_t raw_offset = entry != index.end() ? entry->raw_offset : 0;
+  block_decoder decoder;
+  std::vector<atom_char_t> raw;
+  while (raw_offset < end) {
+    if (pos >= size) {
+      throw std::runtime_error("Broken file");
+    }
+    std::size_t block = block_decoder::block_size(data + pos, size - pos);
+    if (block == 0) {
+      break;
+    }
+    std::size_t raw_size = block_decoder::raw_size(data + pos);
+    if (entry != index.end() && ++entry != index.end() &&
+        (entry->encoded_offset != pos + block || entry->raw_offset != raw_offset + raw_size)) {
+      // every walked block is checked against the next entry, so a broken index can't shift the range
+      throw std::runtime_error("Broken file");
+    }
+    if (raw_offset + raw_size > offset) {
+      raw.clear();
+      decoder.decode(data + pos, block, raw, options.table.get());
+      write_overlap(raw, raw_offset, offset, end, out);
+    }
+    raw_offset += raw_size;
+    pos += block;
+  }
+  if (out.fail()) {
+    throw std::runtime_error("Writing error");
   }
-  out.write(buf.data(), buf_ind);
 }
 } // namespace huffman
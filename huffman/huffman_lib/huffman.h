@@ -8,9 +8,55 @@
 #include "utils/constants.h"
 
 #include <istream>
+#include <memory>
 
 namespace huffman {
-void encode(std::istream& in, std::ostream& out);
-void decode(std::istream& in, std::ostream& out);
+class shared_table;
+
+struct encode_options {
+  // Size of independently coded blocks. Blocks are encoded in a single pass, so the input may be a pipe;
+  // 0 selects the single-table format, which reads the input twice and needs a seekable stream. Decoders older
+  // than the block format read only the single-table one.
+  std::size_t block_size = BLOCK_SIZE;
+  // Number of threads encoding blocks in parallel, the output doesn't depend on it
+  std::size_t threads = 1;
+  // Blocks are coded with this table instead of their own ones and carry only its id, needs block_size != 0
+  std::shared_ptr<const shared_table> table;
+  // Blocks may code every byte with a table selected by the byte before it, which suits text. Encoding gets
+  // slower, decoding needs no option. Ignored by the single-table format and with a shared table.
+  bool context_model = false;
+};
+
+struct decode_options {
+  // Number of threads decoding blocks in parallel. The single-table format in memory is split into chunks decoded
+  // from guessed code boundaries: Huffman codes resynchronise after a few symbols, so every chunk but a few first
+  // symbols is reused once the previous one shows where its codes really start. A stream is decoded by one thread.
+  std::size_t threads = 1;
+  // Table the blocks were coded with, if any
+  std::shared_ptr<const shared_table> table;
+};
+
+void encode(std::istream& in, std::ostream& out, const encode_options& options = {});
+void decode(std::istream& in, std::ostream& out, const decode_options& options = {});
+
+// In-memory input, e.g. a mapped file: nothing is copied and the single-table format reads the input only once
+void encode(const atom_char_t* data, std::size_t size, std::ostream& out, const encode_options& options = {});
+void decode(const unsigned char* data, std::size_t size, std::ostream& out, const decode_options& options = {});
+
+// Size of the data a block stream decodes to, summed from the block headers without decoding the payloads.
+// The single-table format doesn't record it.
+std::size_t decoded_size(const unsigned char* data, std::size_t size);
+// Decodes straight into [out, out + capacity), e.g. an arena or a mapped file, and returns the decoded size. Every
+// block is decoded to its place, in parallel with options.threads; throws if the data doesn't fit.
+std::size_t decode_into(const unsigned char* data, std::size_t size, atom_char_t* out, std::size_t capacity,
+                        const decode_options& options = {});
+
+// Decodes bytes [offset, offset + length) of a block stream, the range is cut at the end of the data.
+// Only the blocks overlapping the range are decoded; in memory the first of them is found by the index at the end
+// of the stream, a stream is read up to the end of the range.
+void decode_range(std::istream& in, std::ostream& out, std::size_t offset, std::size_t length,
+                  const decode_options& options = {});
+void decode_range(const unsigned char* data, std::size_t size, std::ostream& out, std::size_t offset,
+                  std::size_t length, const decode_options& options = {});
 } // namespace huffman
 #endif // HUFFMAN_HUFFMAN_H
@@ -0,0 +1,705 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "block_codec.h"
+
+#include "../binary_io/bit_writer.h"
+#include "../huffman_freq/freq.h"
+#include "../utils/checksum.h"
+#include "../utils/stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace huffman {
+namespace {
+constexpr std::size_t BITMAP_SIZE = NUMBER_ATOM_CHARS / ATOM_CHAR_SIZE;
+// Smaller blocks are decoded faster than the decoding table is paired
+constexpr std::size_t PAIR_SYMBOLS_MIN_SIZE = 16384;
+// Smaller blocks are split into streams too short to make up for the jump table and the extra tails
+constexpr std::size_t INTERLEAVED_MIN_SIZE = 16384;
+// Blocks Huffman codes would shrink by less than 1/64 are stored, decoding them would cost more than it saves
+constexpr std::size_t STORED_SAVING_SHIFT = 6;
+constexpr std::size_t VARINT_BITS = 7;
+constexpr std::size_t MAX_VARINT_SIZE = 5;
+
+void write_u32(std::vector<unsigned char>& out, std::size_t value) {
+  for (std::size_t shift = 32; shift != 0; shift -= ATOM_CHAR_SIZE) {
+    out.push_back(static_cast<unsigned char>(value >> (shift - ATOM_CHAR_SIZE)));
+  }
+}
+
+void put_u32(unsigned char* data, std::size_t value) {
+  for (std::size_t i = 0; i != 4; ++i) {
+    data[i] = static_cast<unsigned char>(value >> (24 - i * ATOM_CHAR_SIZE));
+  }
+}
+
+std::size_t read_u32(const unsigned char* data) {
+  std::size_t value = 0;
+  for (std::size_t i = 0; i != 4; ++i) {
+    value = value << ATOM_CHAR_SIZE | data[i];
+  }
+  return value;
+}
+
+void write_u64(std::vector<unsigned char>& out, uint64_t value) {
+  write_u32(out, value >> 32);
+  write_u32(out, value & 0xFFFFFFFF);
+}
+
+uint64_t read_u64(const unsigned char* data) {
+  return static_cast<uint64_t>(read_u32(data)) << 32 | read_u32(data + 4);
+}
+
+// Blocks keep the low half of the XXH64 of their raw data
+std::size_t block_checksum(const atom_char_t* data, std::size_t size) {
+  stage_timer timer(stage::checksum, size);
+  return xxhash64(data, size) & 0xFFFFFFFF;
+}
+
+void write_varint(std::vector<unsigned char>& out, std::size_t value) {
+  for (; value >> VARINT_BITS != 0; value >>= VARINT_BITS) {
+    out.push_back(static_cast<unsigned char>(value | 1 << VARINT_BITS));
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+std::size_t varint_size(std::size_t value) {
+  std::size_t size = 1;
+  for (; value >> VARINT_BITS != 0; value >>= VARINT_BITS) {
+    size++;
+  }
+  return size;
+}
+
+constexpr std::size_t INDEX_ENTRY_SIZE = 2 * sizeof(uint64_t);
+constexpr std::size_t INDEX_TRAILER_SIZE = 4 + INDEX_MAGIC.size();
+
+std::size_t bitmap_count(const unsigned char* bitmap) {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i != BITMAP_SIZE; ++i) {
+    for (unsigned char byte = bitmap[i]; byte != 0; byte &= byte - 1) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void read_exact(std::streambuf& in, std::vector<unsigned char>& block, std::size_t size) {
+  std::size_t old_size = block.size();
+  block.resize(old_size + size);
+  if (static_cast<std::size_t>(in.sgetn(reinterpret_cast<char*>(block.data() + old_size), size)) != size) {
+    throw std::runtime_error("Broken file");
+  }
+}
+
+// Appends the payload size and the codes of the `size` bytes of a block, which take at most `payload_bits` bits,
+// split into `streams` streams. `code_at(i, begin)` is the code of byte i of the stream starting at byte `begin`.
+template <typename code_at_t>
+void write_payload(std::size_t size, code_at_t code_at, std::size_t payload_bits, std::size_t streams,
+                   std::vector<unsigned char>& out) {
+  stage_timer timer(stage::encode, size);
+  count_symbols(size, payload_bits);
+  std::size_t payload_size_pos = out.size();
+  write_u32(out, 0);
+  std::size_t payload_pos = out.size();
+  std::size_t jump_size = (streams - 1) * 4;
+  out.resize(payload_pos + jump_size + payload_bits / ATOM_CHAR_SIZE + streams + 2 * sizeof(out_char_t));
+  std::size_t segment = (size + streams - 1) / streams;
+  unsigned char* stream = out.data() + payload_pos + jump_size;
+  for (std::size_t k = 0; k != streams; ++k) {
+    bit_writer writer(stream);
+    for (std::size_t i = k * segment; i < std::min(size, (k + 1) * segment); ++i) {
+      encode_code code = code_at(i, k * segment);
+      writer.write(code.code, code.len);
+    }
+    unsigned char* stream_end = writer.flush();
+    if (k + 1 != streams) {
+      put_u32(out.data() + payload_pos + k * 4, stream_end - stream);
+    }
+    stream = stream_end;
+  }
+  std::size_t payload_size = stream - (out.data() + payload_pos);
+  out.resize(payload_pos + payload_size);
+  put_u32(out.data() + payload_size_pos, payload_size);
+}
+
+// Entropy of the histogram, with every byte taking at least the one bit of its Huffman code, plus the code lengths:
+// about the size of the Huffman coded block
+double huffman_size_estimate(const std::vector<int_freq_t>& freq, std::size_t size) {
+  double bits = 0;
+  std::size_t symbols = 0;
+  for (int_freq_t el : freq) {
+    if (el != 0) {
+      bits += static_cast<double>(el) * std::max(1.0, std::log2(static_cast<double>(size) / static_cast<double>(el)));
+      symbols++;
+    }
+  }
+  return bits / ATOM_CHAR_SIZE + BITMAP_SIZE + symbols;
+}
+
+// Payload size of the runs of [data, data + size), counting stops once it exceeds `limit`
+std::size_t rle_size(const atom_char_t* data, std::size_t size, std::size_t limit) {
+  std::size_t result = 0;
+  for (std::size_t i = 0; i != size && result <= limit;) {
+    std::size_t run = 1;
+    while (i + run != size && data[i + run] == data[i]) {
+      run++;
+    }
+    result += 1 + varint_size(run - 1);
+    i += run;
+  }
+  return result;
+}
+
+void write_runs(const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out) {
+  stage_timer timer(stage::encode, size);
+  std::size_t payload_size_pos = out.size();
+  write_u32(out, 0);
+  std::size_t payload_pos = out.size();
+  for (std::size_t i = 0; i != size;) {
+    std::size_t run = 1;
+    while (i + run != size && data[i + run] == data[i]) {
+      run++;
+    }
+    out.push_back(data[i]);
+    write_varint(out, run - 1);
+    i += run;
+  }
+  put_u32(out.data() + payload_size_pos, out.size() - payload_pos);
+}
+
+// Bitmap of the bytes having a code followed by their code lengths
+void write_code_len(const encode_table& table, std::vector<unsigned char>& out) {
+  std::array<unsigned char, BITMAP_SIZE> bitmap{};
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if (table[el].len != 0) {
+      bitmap[el / ATOM_CHAR_SIZE] |= 1 << (el % ATOM_CHAR_SIZE);
+    }
+  }
+  out.insert(out.end(), bitmap.begin(), bitmap.end());
+  for (const encode_code& code : table) {
+    if (code.len != 0) {
+      out.push_back(code.len);
+    }
+  }
+}
+
+// Bytes taken by the bitmap and code lengths of `table`
+std::size_t code_len_size(const encode_table& table) {
+  return BITMAP_SIZE + std::count_if(table.begin(), table.end(), [](const encode_code& code) { return code.len != 0; });
+}
+
+// Entropy of the group histograms plus the group map and the code lengths of every group
+double context_size_estimate(const std::vector<std::vector<int_freq_t>>& group_freq) {
+  double size = 1 + NUMBER_ATOM_CHARS / 2;
+  for (const std::vector<int_freq_t>& freq : group_freq) {
+    size += huffman_size_estimate(freq, std::accumulate(freq.begin(), freq.end(), std::size_t(0)));
+  }
+  return size;
+}
+
+atom_char_t block_header(block_type type, std::size_t size) {
+  atom_char_t header = static_cast<atom_char_t>(type);
+  return size >= INTERLEAVED_MIN_SIZE ? header | INTERLEAVED_FLAG : header;
+}
+
+std::size_t stream_count(std::size_t size) {
+  return size >= INTERLEAVED_MIN_SIZE ? INTERLEAVED_STREAMS : 1;
+}
+
+block_type header_type(atom_char_t header) {
+  if (header == static_cast<atom_char_t>(block_type::end) || header == static_cast<atom_char_t>(block_type::index) ||
+      header == static_cast<atom_char_t>(block_type::stored) || header == static_cast<atom_char_t>(block_type::rle)) {
+    return static_cast<block_type>(header);
+  }
+  atom_char_t type = header & ~INTERLEAVED_FLAG;
+  if (type != static_cast<atom_char_t>(block_type::huffman) && type != static_cast<atom_char_t>(block_type::shared) &&
+      type != static_cast<atom_char_t>(block_type::context)) {
+    throw std::runtime_error("Unknown block type");
+  }
+  return static_cast<block_type>(type);
+}
+
+// Decodes the payload of an interleaved block
+template <typename tree_t>
+void decode_streams(const tree_t& tree, const unsigned char* payload, std::size_t payload_size, atom_char_t* out,
+                    std::size_t raw_size) {
+  std::size_t jump_size = (INTERLEAVED_STREAMS - 1) * 4;
+  if (payload_size < jump_size) {
+    throw std::runtime_error("Broken file");
+  }
+  std::array<bit_stream, INTERLEAVED_STREAMS> streams{};
+  std::size_t segment = (raw_size + INTERLEAVED_STREAMS - 1) / INTERLEAVED_STREAMS;
+  std::size_t offset = jump_size;
+  for (std::size_t k = 0; k != INTERLEAVED_STREAMS; ++k) {
+    std::size_t stream_size = k + 1 != INTERLEAVED_STREAMS ? read_u32(payload + k * 4) : payload_size - offset;
+    if (stream_size > payload_size - offset) {
+      throw std::runtime_error("Broken file");
+    }
+    streams[k] = {offset * ATOM_CHAR_SIZE, (offset + stream_size) * ATOM_CHAR_SIZE,
+                  out + std::min(raw_size, k * segment), out + std::min(raw_size, (k + 1) * segment)};
+    offset += stream_size;
+  }
+  tree.decode_interleaved(payload, streams);
+  std::size_t unread_bits = 0;
+  for (const bit_stream& stream : streams) {
+    if (stream.out != stream.out_end || stream.end - stream.pos >= ATOM_CHAR_SIZE) {
+      throw std::runtime_error("Broken file");
+    }
+    unread_bits += stream.end - stream.pos;
+  }
+  count_symbols(raw_size, (payload_size - jump_size) * ATOM_CHAR_SIZE - unread_bits);
+}
+
+class span_reader {
+public:
+  span_reader(const unsigned char* data, std::size_t size) : data(data), size(size), pos(0) {}
+
+  const unsigned char* take(std::size_t count) {
+    if (size - pos < count) {
+      throw std::runtime_error("Broken file");
+    }
+    pos += count;
+    return data + pos - count;
+  }
+
+  std::size_t position() const {
+    return pos;
+  }
+
+private:
+  const unsigned char* data;
+  std::size_t size;
+  std::size_t pos;
+};
+
+void read_code_len(span_reader& reader, std::vector<atom_char_t>& code_len) {
+  const unsigned char* bitmap = reader.take(BITMAP_SIZE);
+  const unsigned char* lens = reader.take(bitmap_count(bitmap));
+  code_len.assign(NUMBER_ATOM_CHARS, 0);
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if ((bitmap[el / ATOM_CHAR_SIZE] >> (el % ATOM_CHAR_SIZE)) & 1) {
+      code_len[el] = *lens++;
+    }
+  }
+}
+
+template <typename tree_t>
+void decode_payload(const tree_t& tree, atom_char_t header, const unsigned char* payload, std::size_t payload_size,
+                    atom_char_t* out, std::size_t raw_size) {
+  stage_timer timer(stage::decode, raw_size);
+  if ((header & INTERLEAVED_FLAG) == 0) {
+    std::size_t pos = 0;
+    std::size_t end = payload_size * ATOM_CHAR_SIZE;
+    if (tree.decode_unpadded(payload, pos, end, out, out + raw_size) != out + raw_size ||
+        end - pos >= ATOM_CHAR_SIZE) {
+      throw std::runtime_error("Broken file");
+    }
+    count_symbols(raw_size, pos);
+  } else {
+    decode_streams(tree, payload, payload_size, out, raw_size);
+  }
+}
+
+std::size_t read_varint(span_reader& reader) {
+  std::size_t value = 0;
+  for (std::size_t i = 0; i != MAX_VARINT_SIZE; ++i) {
+    atom_char_t byte = *reader.take(1);
+    value |= static_cast<std::size_t>(byte & ((1 << VARINT_BITS) - 1)) << (i * VARINT_BITS);
+    if ((byte >> VARINT_BITS) == 0) {
+      return value;
+    }
+  }
+  throw std::runtime_error("Broken file");
+}
+
+void decode_runs(const unsigned char* payload, std::size_t payload_size, atom_char_t* out, std::size_t raw_size) {
+  stage_timer timer(stage::decode, raw_size);
+  span_reader reader(payload, payload_size);
+  std::size_t pos = 0;
+  while (reader.position() != payload_size) {
+    atom_char_t value = *reader.take(1);
+    std::size_t run = read_varint(reader);
+    if (run >= raw_size - pos) {
+      throw std::runtime_error("Broken file");
+    }
+    std::memset(out + pos, value, run + 1);
+    pos += run + 1;
+  }
+  if (pos != raw_size) {
+    throw std::runtime_error("Broken file");
+  }
+}
+
+// Writes the block header shared by all types up to the payload size
+void write_header(atom_char_t header, const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out) {
+  out.push_back(header);
+  write_u32(out, size);
+  write_u32(out, block_checksum(data, size));
+}
+
+void encode_stored(const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out) {
+  write_header(static_cast<atom_char_t>(block_type::stored), data, size, out);
+  write_u32(out, size);
+  out.insert(out.end(), data, data + size);
+}
+
+std::size_t stored_limit(std::size_t size) {
+  return size - (size >> STORED_SAVING_SHIFT);
+}
+} // namespace
+
+void block_encoder::encode(const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out,
+                           bool context_model) {
+  freq.assign(NUMBER_ATOM_CHARS, 0);
+  count_freq(data, size, freq);
+  double huffman_size = huffman_size_estimate(freq, size);
+  // Runs are only looked for if a byte fills more than half of the block, Huffman codes are close to their minimum
+  // of a bit per byte there
+  if (*std::max_element(freq.begin(), freq.end()) > size / 2) {
+    std::size_t limit = std::min(static_cast<std::size_t>(huffman_size), stored_limit(size));
+    if (rle_size(data, size, limit) < limit) {
+      write_header(static_cast<atom_char_t>(block_type::rle), data, size, out);
+      write_runs(data, size, out);
+      return;
+    }
+  }
+  bool stored = huffman_size >= static_cast<double>(stored_limit(size));
+  encode_table table{};
+  std::size_t payload_bits = 0;
+  std::size_t limit = stored_limit(size);
+  if (!stored) {
+    table = convert_tree::get_encode_table(freq);
+    for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+      payload_bits += freq[el] * table[el].len;
+    }
+    limit = std::min(limit, code_len_size(table) + (payload_bits + ATOM_CHAR_SIZE - 1) / ATOM_CHAR_SIZE);
+  }
+  if (context_model && encode_context(data, size, limit, out)) {
+    return;
+  }
+  if (stored) {
+    encode_stored(data, size, out);
+    return;
+  }
+
+  write_header(block_header(block_type::huffman, size), data, size, out);
+  write_code_len(table, out);
+  write_payload(
+      size, [&table, data](std::size_t i, std::size_t) { return table[data[i]]; }, payload_bits, stream_count(size),
+      out);
+}
+
+bool block_encoder::encode_context(const atom_char_t* data, std::size_t size, std::size_t limit,
+                                   std::vector<unsigned char>& out) {
+  std::size_t streams = stream_count(size);
+  std::size_t segment = (size + streams - 1) / streams;
+  pair_freq.assign(NUMBER_ATOM_CHARS * NUMBER_ATOM_CHARS, 0);
+  for (std::size_t begin = 0; begin < size; begin += segment) {
+    count_pair_freq(data + begin, std::min(segment, size - begin), 0, pair_freq);
+  }
+  std::array<atom_char_t, NUMBER_ATOM_CHARS> groups = cluster_contexts(pair_freq, MAX_CONTEXT_GROUPS);
+  std::size_t count = *std::max_element(groups.begin(), groups.end()) + std::size_t(1);
+  group_freq.assign(count, std::vector<int_freq_t>(NUMBER_ATOM_CHARS));
+  for (std::size_t context = 0; context != NUMBER_ATOM_CHARS; ++context) {
+    for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+      group_freq[groups[context]][el] += pair_freq[context * NUMBER_ATOM_CHARS + el];
+    }
+  }
+  if (context_size_estimate(group_freq) >= static_cast<double>(limit)) {
+    return false;
+  }
+  std::vector<encode_table> tables(count);
+  for (std::size_t group = 0; group != count; ++group) {
+    complete_freq(group_freq[group]);
+    tables[group] = convert_tree::get_encode_table(group_freq[group]);
+  }
+  std::size_t payload_bits = 0;
+  for (std::size_t context = 0; context != NUMBER_ATOM_CHARS; ++context) {
+    for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+      payload_bits += pair_freq[context * NUMBER_ATOM_CHARS + el] * tables[groups[context]][el].len;
+    }
+  }
+  // the group map and code lengths of every group, then the payload
+  std::size_t context_size = 1 + NUMBER_ATOM_CHARS / 2 + (payload_bits + ATOM_CHAR_SIZE - 1) / ATOM_CHAR_SIZE;
+  for (const encode_table& table : tables) {
+    context_size += code_len_size(table);
+  }
+  if (context_size >= limit) {
+    return false;
+  }
+
+  write_header(block_header(block_type::context, size), data, size, out);
+  out.push_back(static_cast<unsigned char>(count));
+  for (std::size_t context = 0; context != NUMBER_ATOM_CHARS; context += 2) {
+    out.push_back(static_cast<unsigned char>(groups[context] << 4 | groups[context + 1]));
+  }
+  for (const encode_table& table : tables) {
+    write_code_len(table, out);
+  }
+  write_payload(
+      size,
+      [&tables, &groups, data](std::size_t i, std::size_t begin) {
+        return tables[groups[i == begin ? 0 : data[i - 1]]][data[i]];
+      },
+      payload_bits, streams, out);
+  return true;
+}
+
+void block_encoder::encode_shared(const atom_char_t* data, std::size_t size, const shared_table& table,
+                                  std::vector<unsigned char>& out) {
+  // shared tables have a code for every byte
+  const encode_table& codes = table.encoding();
+  std::size_t payload_bits = 0;
+  for (std::size_t i = 0; i != size; ++i) {
+    payload_bits += codes[data[i]].len;
+  }
+  if ((payload_bits + ATOM_CHAR_SIZE - 1) / ATOM_CHAR_SIZE + 4 >= stored_limit(size)) {
+    encode_stored(data, size, out);
+    return;
+  }
+  write_header(block_header(block_type::shared, size), data, size, out);
+  write_u32(out, table.id());
+  write_payload(
+      size, [&codes, data](std::size_t i, std::size_t) { return codes[data[i]]; }, payload_bits, stream_count(size),
+      out);
+}
+
+void block_encoder::finish(std::vector<unsigned char>& out) {
+  out.push_back(static_cast<unsigned char>(block_type::end));
+}
+
+void block_encoder::finish(const std::vector<index_entry>& index, std::vector<unsigned char>& out) {
+  out.push_back(static_cast<unsigned char>(block_type::index));
+  write_u32(out, index.size());
+  for (const index_entry& entry : index) {
+    write_u64(out, entry.raw_offset);
+    write_u64(out, entry.encoded_offset);
+  }
+  write_u32(out, index.size());
+  out.insert(out.end(), INDEX_MAGIC.begin(), INDEX_MAGIC.end());
+}
+
+bool block_decoder::read(std::streambuf& in, std::vector<unsigned char>& block) {
+  block.clear();
+  read_exact(in, block, 1);
+  block_type type = header_type(block[0]);
+  if (type == block_type::end) {
+    return false;
+  }
+  if (type == block_type::index) {
+    read_exact(in, block, 4);
+    std::size_t count = read_u32(block.data() + 1);
+    if (count > MAX_BLOCK_SIZE) {
+      throw std::runtime_error("Broken file");
+    }
+    read_exact(in, block, count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE);
+    if (read_u32(block.data() + block.size() - INDEX_TRAILER_SIZE) != count ||
+        !std::equal(INDEX_MAGIC.begin(), INDEX_MAGIC.end(), block.end() - INDEX_MAGIC.size())) {
+      throw std::runtime_error("Broken file");
+    }
+    return false;
+  }
+  if (type == block_type::huffman) {
+    read_exact(in, block, 4 + 4 + BITMAP_SIZE);
+    read_exact(in, block, bitmap_count(block.data() + 9) + 4);
+  } else if (type == block_type::context) {
+    read_exact(in, block, 4 + 4 + 1 + NUMBER_ATOM_CHARS / 2);
+    std::size_t count = block[9];
+    if (count == 0 || count > MAX_CONTEXT_GROUPS) {
+      throw std::runtime_error("Broken file");
+    }
+    for (std::size_t group = 0; group != count; ++group) {
+      read_exact(in, block, BITMAP_SIZE);
+      read_exact(in, block, bitmap_count(block.data() + block.size() - BITMAP_SIZE));
+    }
+    read_exact(in, block, 4);
+  } else if (type == block_type::shared) {
+    read_exact(in, block, 4 + 4 + 4 + 4);
+  } else {
+    read_exact(in, block, 4 + 4 + 4);
+  }
+  std::size_t payload_size = read_u32(block.data() + block.size() - 4);
+  if (payload_size > MAX_BLOCK_SIZE * sizeof(out_char_t)) {
+    throw std::runtime_error("Broken file");
+  }
+  read_exact(in, block, payload_size);
+  return true;
+}
+
+std::size_t block_decoder::block_size(const unsigned char* data, std::size_t size) {
+  span_reader reader(data, size);
+  block_type type = header_type(*reader.take(1));
+  if (type == block_type::index) {
+    // the index ends the input, it is only checked to be complete
+    std::size_t count = read_u32(reader.take(4));
+    if (count > MAX_BLOCK_SIZE) {
+      throw std::runtime_error("Broken file");
+    }
+    reader.take(count * INDEX_ENTRY_SIZE);
+    if (read_u32(reader.take(4)) != count ||
+        !std::equal(INDEX_MAGIC.begin(), INDEX_MAGIC.end(), reader.take(INDEX_MAGIC.size()))) {
+      throw std::runtime_error("Broken file");
+    }
+  }
+  if (type == block_type::end || type == block_type::index) {
+    return 0;
+  }
+  if (type == block_type::huffman) {
+    reader.take(4 + 4);
+    reader.take(bitmap_count(reader.take(BITMAP_SIZE)));
+  } else if (type == block_type::context) {
+    reader.take(4 + 4);
+    std::size_t count = *reader.take(1);
+    reader.take(NUMBER_ATOM_CHARS / 2);
+    for (std::size_t group = 0; group != count; ++group) {
+      reader.take(bitmap_count(reader.take(BITMAP_SIZE)));
+    }
+  } else if (type == block_type::shared) {
+    reader.take(4 + 4 + 4);
+  } else {
+    reader.take(4 + 4);
+  }
+  reader.take(read_u32(reader.take(4)));
+  return reader.position();
+}
+
+std::size_t block_decoder::raw_size(const unsigned char* block) {
+  return read_u32(block + 1);
+}
+
+std::vector<index_entry> block_decoder::read_index(const unsigned char* data, std::size_t size) {
+  std::vector<index_entry> index;
+  if (size < INDEX_TRAILER_SIZE || !std::equal(INDEX_MAGIC.begin(), INDEX_MAGIC.end(), data + size - INDEX_MAGIC.size())) {
+    return index;
+  }
+  std::size_t count = read_u32(data + size - INDEX_TRAILER_SIZE);
+  std::size_t index_size = 1 + 4 + count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE;
+  if (count > MAX_BLOCK_SIZE || size < index_size) {
+    throw std::runtime_error("Broken file");
+  }
+  const unsigned char* begin = data + size - index_size;
+  if (*begin != static_cast<unsigned char>(block_type::index) || read_u32(begin + 1) != count) {
+    throw std::runtime_error("Broken file");
+  }
+  // blocks follow each other, the first one right after the magic, and none of them is empty
+  index_entry last{0, BLOCK_MAGIC.size()};
+  for (const unsigned char* entry = begin + 1 + 4; index.size() != count; entry += INDEX_ENTRY_SIZE) {
+    index.push_back({read_u64(entry), read_u64(entry + sizeof(uint64_t))});
+    bool first = index.size() == 1;
+    if (first ? index.back().raw_offset != last.raw_offset || index.back().encoded_offset != last.encoded_offset
+              : index.back().raw_offset <= last.raw_offset || index.back().encoded_offset <= last.encoded_offset) {
+      throw std::runtime_error("Broken file");
+    }
+    last = index.back();
+  }
+  if (last.encoded_offset >= size - index_size && count != 0) {
+    throw std::runtime_error("Broken file");
+  }
+  return index;
+}
+
+std::size_t block_decoder::decode(const unsigned char* data, std::size_t size, std::vector<atom_char_t>& out,
+                                  const shared_table* shared) {
+  // the whole block is checked to be there before its raw size is allocated
+  if (block_size(data, size) == 0) {
+    throw std::runtime_error("Unknown block type");
+  }
+  std::size_t raw_size = block_decoder::raw_size(data);
+  if (raw_size > MAX_BLOCK_SIZE) {
+    throw std::runtime_error("Broken file");
+  }
+  std::size_t out_pos = out.size();
+  out.resize(out_pos + raw_size);
+  return decode(data, size, out.data() + out_pos, shared);
+}
+
+std::size_t block_decoder::decode(const unsigned char* data, std::size_t size, atom_char_t* out,
+                                  const shared_table* shared) {
+  span_reader reader(data, size);
+  atom_char_t header = *reader.take(1);
+  block_type type = header_type(header);
+  if (type == block_type::end || type == block_type::index) {
+    throw std::runtime_error("Unknown block type");
+  }
+  std::size_t raw_size = read_u32(reader.take(4));
+  if (raw_size == 0 || raw_size > MAX_BLOCK_SIZE) {
+    throw std::runtime_error("Broken file");
+  }
+  std::size_t checksum = read_u32(reader.take(4));
+  if (type == block_type::stored || type == block_type::rle) {
+    std::size_t payload_size = read_u32(reader.take(4));
+    const unsigned char* payload = reader.take(payload_size);
+    if (type == block_type::stored) {
+      if (payload_size != raw_size) {
+        throw std::runtime_error("Broken file");
+      }
+      std::memcpy(out, payload, payload_size);
+    } else {
+      decode_runs(payload, payload_size, out, raw_size);
+    }
+    if (block_checksum(out, raw_size) != checksum) {
+      throw std::runtime_error("Checksum mismatch");
+    }
+    return reader.position();
+  }
+  const convert_tree* block_tree = nullptr;
+  if (type == block_type::context) {
+    std::size_t count = *reader.take(1);
+    if (count == 0 || count > MAX_CONTEXT_GROUPS) {
+      throw std::runtime_error("Broken file");
+    }
+    const unsigned char* map = reader.take(NUMBER_ATOM_CHARS / 2);
+    std::array<atom_char_t, NUMBER_ATOM_CHARS> groups{};
+    for (std::size_t context = 0; context != NUMBER_ATOM_CHARS; ++context) {
+      groups[context] = context % 2 == 0 ? map[context / 2] >> 4 : map[context / 2] & 0xF;
+    }
+    group_code_len.resize(count);
+    for (std::vector<atom_char_t>& lens : group_code_len) {
+      read_code_len(reader, lens);
+    }
+    if (groups_tree) {
+      groups_tree->assign(groups, group_code_len);
+    } else {
+      groups_tree.emplace(groups, group_code_len);
+    }
+  } else if (type == block_type::huffman) {
+    read_code_len(reader, code_len);
+    bool pair_symbols = raw_size >= PAIR_SYMBOLS_MIN_SIZE;
+    if (tree) {
+      tree->assign(code_len, pair_symbols);
+    } else {
+      tree.emplace(code_len, pair_symbols);
+    }
+    block_tree = &*tree;
+  } else if (shared == nullptr) {
+    throw std::runtime_error("Block needs a shared table");
+  } else if (read_u32(reader.take(4)) != shared->id()) {
+    throw std::runtime_error("Block was coded with another shared table");
+  } else {
+    block_tree = &shared->decoding();
+  }
+
+  std::size_t payload_size = read_u32(reader.take(4));
+  if (payload_size > raw_size * sizeof(out_char_t)) {
+    throw std::runtime_error("Broken file");
+  }
+  const unsigned char* payload = reader.take(payload_size);
+  if (block_tree != nullptr) {
+    decode_payload(*block_tree, header, payload, payload_size, out, raw_size);
+  } else {
+    decode_payload(*groups_tree, header, payload, payload_size, out, raw_size);
+  }
+  if (block_checksum(out, raw_size) != checksum) {
+    throw std::runtime_error("Checksum mismatch");
+  }
+  return reader.position();
+}
+} // namespace huffman
@@ -0,0 +1,103 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_BLOCK_CODEC_H
+#define HUFFMAN_BLOCK_CODEC_H
+
+#include "../huffman_convert_tree/convert_tree.h"
+#include "../huffman_shared/shared_table.h"
+#include "../utils/constants.h"
+
+#include <array>
+#include <optional>
+#include <streambuf>
+#include <vector>
+
+namespace huffman {
+// Block streams start with the magic, its first byte can't be a code length of the single-table format
+constexpr std::array<unsigned char, 4> BLOCK_MAGIC = {'H', 'U', 'F', 2};
+// Last bytes of a stream ending with an index
+constexpr std::array<unsigned char, 4> INDEX_MAGIC = {'H', 'U', 'I', 1};
+
+enum class block_type : atom_char_t {
+  end = 0,
+  huffman = 1,
+  // coded with a table both sides know in advance, the block carries its id instead of the code lengths
+  shared = 2,
+  // end of a stream followed by the block count, an index_entry per block, the block count again and INDEX_MAGIC,
+  // so the index is found from the end of the stream
+  index = 3,
+  // raw data as it is, for blocks Huffman codes wouldn't shrink
+  stored = 4,
+  // runs of equal bytes: the byte and the run length less one as a little-endian base-128 varint
+  rle = 5,
+  // order-1 codes: the number of code groups, the group of every preceding byte as 4-bit nibbles and the code
+  // lengths of every group, then the payload like a huffman block. Streams start after a zero byte.
+  context = 6,
+};
+
+// Groups of preceding bytes sharing a code in context blocks
+constexpr std::size_t MAX_CONTEXT_GROUPS = 16;
+
+// Offsets of a block in the decoded data and in the stream, which starts with BLOCK_MAGIC
+struct index_entry {
+  uint64_t raw_offset;
+  uint64_t encoded_offset;
+};
+
+// Set in the type of blocks whose payload is split into INTERLEAVED_STREAMS streams: the sizes of all streams but
+// the last one, then the streams. Stream k codes the k-th quarter of the block, rounded up.
+constexpr atom_char_t INTERLEAVED_FLAG = 0x80;
+
+// Every block carries its type, raw size, checksum of the raw data, code lengths and payload size, so blocks are
+// self-delimiting, can be written as soon as they are read and decoded without the blocks before them.
+class block_encoder {
+public:
+  // Picks the stored, RLE or Huffman type from the entropy of the block's histogram. With `context_model`
+  // the context type is picked too if it comes out smaller.
+  void encode(const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out, bool context_model = false);
+  static void encode_shared(const atom_char_t* data, std::size_t size, const shared_table& table,
+                            std::vector<unsigned char>& out);
+  static void finish(std::vector<unsigned char>& out);
+  static void finish(const std::vector<index_entry>& index, std::vector<unsigned char>& out);
+
+private:
+  // Writes a context block and returns true if its code lengths and payload take less than `limit` bytes
+  bool encode_context(const atom_char_t* data, std::size_t size, std::size_t limit, std::vector<unsigned char>& out);
+
+  std::vector<int_freq_t> freq;
+  std::vector<int_freq_t> pair_freq;
+  std::vector<std::vector<int_freq_t>> group_freq;
+};
+
+// Blocks are read from the stream as they are and decoded from memory afterwards,
+// so reading and decoding of different blocks may run in parallel.
+class block_decoder {
+public:
+  // Reads the next encoded block of `in` into `block`, returns false once the end of the stream is reached
+  static bool read(std::streambuf& in, std::vector<unsigned char>& block);
+  // Returns the encoded size of the block at the beginning of [data, data + size), 0 for the end of the stream
+  static std::size_t block_size(const unsigned char* data, std::size_t size);
+  // Raw size of a block whose encoded size is known
+  static std::size_t raw_size(const unsigned char* block);
+  // Index of the stream [data, data + size), empty if the stream doesn't end with one
+  static std::vector<index_entry> read_index(const unsigned char* data, std::size_t size);
+  // Appends the block at the beginning of [data, data + size) to `out` and returns its encoded size.
+  // Blocks of the shared type are decoded with `shared`, which must be the table they were coded with.
+  // Throws if the decoded data doesn't match the checksum.
+  std::size_t decode(const unsigned char* data, std::size_t size, std::vector<atom_char_t>& out,
+                     const shared_table* shared = nullptr);
+  // Same, but writes the block to [out, out + raw_size(data)) provided by the caller, who checks the block with
+  // block_size first
+  std::size_t decode(const unsigned char* data, std::size_t size, atom_char_t* out,
+                     const shared_table* shared = nullptr);
+
+private:
+  std::vector<atom_char_t> code_len;
+  std::optional<convert_tree> tree;
+  std::vector<std::vector<atom_char_t>> group_code_len;
+  std::optional<context_tree> groups_tree;
+};
+} // namespace huffman
+#endif // HUFFMAN_BLOCK_CODEC_H
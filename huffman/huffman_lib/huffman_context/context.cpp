@@ -0,0 +1,47 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "context.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace huffman {
+encoder::encoder(const encode_options& options)
+    : block_size(options.block_size == 0 ? MAX_BLOCK_SIZE : options.block_size),
+      table(options.table),
+      context_model(options.context_model) {
+  if (options.block_size > MAX_BLOCK_SIZE) {
+    throw std::runtime_error("Block size is too big");
+  }
+}
+
+void encoder::encode(const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out) {
+  out.assign(BLOCK_MAGIC.begin(), BLOCK_MAGIC.end());
+  for (std::size_t pos = 0; pos != size;) {
+    std::size_t block = std::min(block_size, size - pos);
+    if (table) {
+      block_encoder::encode_shared(data + pos, block, *table, out);
+    } else {
+      blocks.encode(data + pos, block, out, context_model);
+    }
+    pos += block;
+  }
+  block_encoder::finish(out);
+}
+
+decoder::decoder(const decode_options& options) : table(options.table) {}
+
+void decoder::decode(const unsigned char* data, std::size_t size, std::vector<atom_char_t>& out) {
+  if (size < BLOCK_MAGIC.size() || !std::equal(BLOCK_MAGIC.begin(), BLOCK_MAGIC.end(), data)) {
+    throw std::runtime_error("Broken file");
+  }
+  out.clear();
+  std::size_t pos = BLOCK_MAGIC.size();
+  while (std::size_t block = block_decoder::block_size(data + pos, size - pos)) {
+    blocks.decode(data + pos, block, out, table.get());
+    pos += block;
+  }
+}
+} // namespace huffman
@@ -0,0 +1,45 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_CONTEXT_H
+#define HUFFMAN_CONTEXT_H
+
+#include "../huffman.h"
+#include "../huffman_block/block_codec.h"
+#include "../huffman_shared/shared_table.h"
+#include "../utils/constants.h"
+
+#include <memory>
+#include <vector>
+
+namespace huffman {
+// Encoding context for many messages: tables and buffers are kept between calls.
+// Messages are block streams, huffman::decode reads them given the same options.
+class encoder {
+public:
+  explicit encoder(const encode_options& options = {});
+
+  // Replaces `out` with the encoded [data, data + size), its capacity is reused
+  void encode(const atom_char_t* data, std::size_t size, std::vector<unsigned char>& out);
+
+private:
+  std::size_t block_size;
+  std::shared_ptr<const shared_table> table;
+  bool context_model;
+  block_encoder blocks;
+};
+
+class decoder {
+public:
+  explicit decoder(const decode_options& options = {});
+
+  // Replaces `out` with the decoded [data, data + size), its capacity is reused
+  void decode(const unsigned char* data, std::size_t size, std::vector<atom_char_t>& out);
+
+private:
+  std::shared_ptr<const shared_table> table;
+  block_decoder blocks;
+};
+} // namespace huffman
+#endif // HUFFMAN_CONTEXT_H
@@ -4,122 +4,591 @@
 
 #include "convert_tree.h"
 
-#include <set>
+#include "../utils/bit_utils.h"
+#include "../utils/stats.h"
+
+#include <algorithm>
+#include <array>
+#include <iterator>
 #include <stdexcept>
 
 namespace huffman {
-convert_tree::base_node::base_node(base_node* left, base_node* right) : left(left), right(right) {}
+namespace {
+constexpr std::size_t ENTRY_LEN_SHIFT = 16;
+constexpr std::size_t ENTRY_COUNT_SHIFT = 24;
+
+constexpr uint32_t make_entry(std::size_t value, std::size_t len, std::size_t count) {
+  return static_cast<uint32_t>(value | len << ENTRY_LEN_SHIFT | count << ENTRY_COUNT_SHIFT);
+}
+
+constexpr std::size_t entry_value(uint32_t entry) {
+  return entry & ((1 << ENTRY_LEN_SHIFT) - 1);
+}
+
+constexpr std::size_t entry_len(uint32_t entry) {
+  return (entry >> ENTRY_LEN_SHIFT) & MAX_ATOM_CHAR;
+}
+
+constexpr std::size_t entry_count(uint32_t entry) {
+  return entry >> ENTRY_COUNT_SHIFT;
+}
+
+// Link entries keep len == 0, so a lookup of one consumes nothing
+constexpr std::size_t LINK_BITS_SHIFT = 12;
+
+constexpr uint32_t make_link(std::size_t index, std::size_t bits) {
+  return make_entry(index | bits << LINK_BITS_SHIFT, 0, 0);
+}
+
+constexpr std::size_t link_index(uint32_t entry) {
+  return entry_value(entry) & ((1 << LINK_BITS_SHIFT) - 1);
+}
+
+constexpr std::size_t link_bits(uint32_t entry) {
+  return entry_value(entry) >> LINK_BITS_SHIFT;
+}
 
-convert_tree::base_node::~base_node() {
-  if (!is_leaf()) {
-    delete left;
-    delete right;
+// Optimal code lengths not longer than max_len for the symbols with nonzero frequencies. Every list holds
+// the leaves merged with the pairs of the previous list; the first 2n - 2 items of the last list and the items
+// their pairs consist of make up the code, a symbol gets one bit for every list its leaf is taken from.
+std::array<std::size_t, NUMBER_ATOM_CHARS> limit_code_len(const std::vector<int_freq_t>& freq, std::size_t max_len) {
+  struct item {
+    int_freq_t weight;
+    std::size_t leaf;
+  };
+  constexpr std::size_t PAIR = NUMBER_ATOM_CHARS;
+
+  std::vector<item> leaves;
+  for (std::size_t el = 0; el != freq.size(); ++el) {
+    if (freq[el] != 0) {
+      leaves.push_back({freq[el], el});
+    }
+  }
+  std::stable_sort(leaves.begin(), leaves.end(), [](const item& a, const item& b) { return a.weight < b.weight; });
+
+  std::vector<std::vector<item>> lists(max_len);
+  lists[0] = leaves;
+  for (std::size_t level = 1; level != max_len; ++level) {
+    const std::vector<item>& prev = lists[level - 1];
+    std::vector<item> pairs;
+    for (std::size_t i = 0; i + 1 < prev.size(); i += 2) {
+      pairs.push_back({prev[i].weight + prev[i + 1].weight, PAIR});
+    }
+    std::merge(leaves.begin(), leaves.end(), pairs.begin(), pairs.end(), std::back_inserter(lists[level]),
+               [](const item& a, const item& b) { return a.weight < b.weight; });
   }
+
+  std::array<std::size_t, NUMBER_ATOM_CHARS> code_len{};
+  std::size_t take = 2 * leaves.size() - 2;
+  for (std::size_t level = max_len; level != 0; --level) {
+    std::size_t pairs = 0;
+    for (std::size_t i = 0; i != take; ++i) {
+      if (lists[level - 1][i].leaf == PAIR) {
+        pairs++;
+      } else {
+        code_len[lists[level - 1][i].leaf]++;
+      }
+    }
+    take = 2 * pairs;
+  }
+  return code_len;
 }
 
-bool convert_tree::base_node::is_leaf() const {
-  return left == nullptr && right == nullptr;
+// Huffman code lengths in place (Moffat and Katajainen): `weight` holds n >= 2 frequencies in ascending order and
+// gets the code length of each. The first pass merges the two lightest items like the two-queue method, the leaves
+// are read from the front of the unread weights and the internal nodes from the front of the merged ones, which keep
+// the index of their parent; the next passes turn parent indices into depths and depths of internal nodes into
+// the leaf depths. The longest code goes to weight[0].
+void minimum_redundancy_len(int_freq_t* weight, std::size_t n) {
+  weight[0] += weight[1];
+  std::size_t root = 0, leaf = 2;
+  for (std::size_t next = 1; next != n - 1; ++next) {
+    if (leaf >= n || weight[root] < weight[leaf]) {
+      weight[next] = weight[root];
+      weight[root++] = next;
+    } else {
+      weight[next] = weight[leaf++];
+    }
+    if (leaf >= n || (root < next && weight[root] < weight[leaf])) {
+      weight[next] += weight[root];
+      weight[root++] = next;
+    } else {
+      weight[next] += weight[leaf++];
+    }
+  }
+  weight[n - 2] = 0;
+  for (std::size_t next = n - 2; next-- != 0;) {
+    weight[next] = weight[weight[next]] + 1;
+  }
+  std::size_t available = 1, used = 0, depth = 0, next = n;
+  for (std::ptrdiff_t internal = static_cast<std::ptrdiff_t>(n) - 2; available != 0; ++depth) {
+    for (; internal >= 0 && weight[internal] == depth; --internal) {
+      used++;
+    }
+    for (; available > used; --available) {
+      weight[--next] = depth;
+    }
+    available = 2 * used;
+    used = 0;
+  }
 }
 
-void convert_tree::base_node::get_len_code(std::size_t actual_len, std::vector<std::set<atom_char_t>>& len_code) {
-  if (is_leaf()) {
-    len_code[actual_len].insert(static_cast<node*>(this)->value);
-  } else {
-    actual_len++;
-    left->get_len_code(actual_len, len_code);
-    right->get_len_code(actual_len, len_code);
+// Canonical codes for NUMBER_ATOM_CHARS lengths in the same order convert_tree assigns them: shorter codes first,
+// equal lengths ordered by symbol. Lengths above MAX_ENCODE_CODE_LEN get no code.
+encode_table canonical_table(const atom_char_t* code_len) {
+  std::array<uint32_t, MAX_ENCODE_CODE_LEN + 1> count{};
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if (code_len[el] <= MAX_ENCODE_CODE_LEN) {
+      count[code_len[el]]++;
+    }
+  }
+  count[0] = 0;
+  std::array<uint32_t, MAX_ENCODE_CODE_LEN + 1> next{};
+  uint32_t code = 0;
+  for (std::size_t len = 1; len <= MAX_ENCODE_CODE_LEN; ++len) {
+    code = (code + count[len - 1]) << 1;
+    next[len] = code;
   }
+  encode_table table{};
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if (code_len[el] != 0 && code_len[el] <= MAX_ENCODE_CODE_LEN) {
+      table[el] = {next[code_len[el]]++, code_len[el]};
+    }
+  }
+  return table;
 }
+} // namespace
 
-convert_tree::node::node(atom_char_t value) : value(value), base_node(nullptr, nullptr) {}
+convert_tree::convert_tree(const std::vector<atom_char_t>& code_len, bool pair_symbols) {
+  assign(code_len, pair_symbols);
+}
 
-convert_tree::node::~node() = default;
+void convert_tree::assign(const std::vector<atom_char_t>& new_code_len, bool pair_symbols) {
+  stage_timer timer(stage::tree);
+  assign(new_code_len, pair_symbols, DECODE_TABLE_BITS);
+}
 
-class convert_tree::freq_node_comparator {
-public:
-  bool operator()(std::pair<int_freq_t, base_node*>& a, std::pair<int_freq_t, base_node*>& b) {
-    return a.first > b.first;
+void convert_tree::assign(const std::vector<atom_char_t>& new_code_len, bool pair_symbols, std::size_t table_bits) {
+  if (new_code_len.size() != NUMBER_ATOM_CHARS) {
+    throw std::runtime_error("Invalid len_code");
   }
-};
-
-void code_len_to_code_table(out_element actual_code, std::map<atom_char_t, out_element>* code_table,
-                            std::map<out_element, atom_char_t, std::greater<>>* decode_table,
-                            std::vector<std::set<atom_char_t>>& len_code) {
-  size_t& len = actual_code[LEN_INDEX_OUT_EL];
-  if (len >= OUT_CHAR_SIZE) {
-    throw std::runtime_error("Invalid decoding file type");
+  // Kraft sum scaled by 2^MAX_CODE_LEN, the code has to be complete to be decoded unambiguously
+  out_char_t kraft_sum = 0;
+  std::size_t max_len = 0;
+  for (atom_char_t len : new_code_len) {
+    if (len > MAX_CODE_LEN) {
+      throw std::runtime_error("Invalid decoding file type");
+    }
+    if (len != 0) {
+      kraft_sum += static_cast<out_char_t>(1) << (MAX_CODE_LEN - len);
+      max_len = std::max<std::size_t>(max_len, len);
+    }
+    if (kraft_sum > static_cast<out_char_t>(1) << MAX_CODE_LEN) {
+      throw std::runtime_error("Invalid len_code");
+    }
+  }
+  if (kraft_sum != static_cast<out_char_t>(1) << MAX_CODE_LEN) {
+    throw std::runtime_error("Invalid len_code");
   }
-  if (len_code[len].size() != 0) {
-    if (code_table != nullptr) {
-      (*code_table)[*len_code[len].begin()] = actual_code;
+  code_len = new_code_len;
+  primary_bits = table_bits;
+  table.assign(static_cast<std::size_t>(1) << primary_bits, 0);
+  sub_table_offset.clear();
+  // canonical code: shorter codes first, equal lengths are ordered by symbol
+  std::array<std::size_t, MAX_CODE_LEN + 1> next{};
+  for (atom_char_t len : code_len) {
+    if (len != MAX_CODE_LEN && len != 0) {
+      next[len + 1]++;
     }
-    if (decode_table != nullptr) {
-      (*decode_table)[actual_code] = *len_code[len].begin();
+  }
+  for (std::size_t len = 2; len <= MAX_CODE_LEN; ++len) {
+    next[len] += next[len - 1];
+  }
+  std::array<atom_char_t, NUMBER_ATOM_CHARS> order{};
+  std::size_t count = 0;
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if (code_len[el] != 0) {
+      order[next[code_len[el]]++] = static_cast<atom_char_t>(el);
+      count++;
     }
-    len_code[len].erase(len_code[len].begin());
+  }
+  out_char_t code = 0;
+  std::size_t prev_len = 0;
+  for (std::size_t i = 0; i != count; ++i) {
+    std::size_t len = code_len[order[i]];
+    code <<= len - prev_len;
+    prev_len = len;
+    fill_table(0, primary_bits, max_len, code++, len, order[i]);
+  }
+  if (pair_symbols) {
+    pair_table();
+  }
+}
+
+void convert_tree::fill_table(std::size_t offset, std::size_t bits, std::size_t max_len, out_char_t code,
+                              std::size_t len, atom_char_t value) {
+  if (len <= bits) {
+    std::size_t first = static_cast<std::size_t>(code) << (bits - len);
+    std::fill_n(table.begin() + offset + first, static_cast<std::size_t>(1) << (bits - len),
+                make_entry(value, len, 1));
     return;
   }
-  len++;
-  code_len_to_code_table(actual_code, code_table, decode_table, len_code);
-  actual_code[(len - 1) / OUT_CHAR_SIZE] += static_cast<unsigned long long>(1)
-                                         << (OUT_CHAR_SIZE - (len % OUT_CHAR_SIZE));
-  code_len_to_code_table(actual_code, code_table, decode_table, len_code);
+  std::size_t index = offset + static_cast<std::size_t>(code >> (len - bits));
+  if (table[index] == 0) {
+    std::size_t sub_bits = std::min(DECODE_TABLE_BITS, max_len - bits);
+    table[index] = make_link(sub_table_offset.size(), sub_bits);
+    sub_table_offset.push_back(table.size());
+    table.resize(table.size() + (static_cast<std::size_t>(1) << sub_bits), 0);
+  }
+  fill_table(sub_table_offset[link_index(table[index])], link_bits(table[index]), max_len - bits,
+             code & ((static_cast<out_char_t>(1) << (len - bits)) - 1), len - bits, value);
 }
 
-convert_tree::convert_tree(std::vector<atom_char_t> code_len) {
-  std::map<atom_char_t, out_element> code_table;
-  std::vector<std::set<atom_char_t>> len_code(NUMBER_ATOM_CHARS);
-  for (size_t i = 0; i != NUMBER_ATOM_CHARS; ++i) {
-    len_code[code_len[i]].insert(i);
-  }
-  len_code[0].clear();
-  code_len_to_code_table({}, nullptr, &decode_table, len_code);
-  for (size_t i = 0; i != NUMBER_ATOM_CHARS; ++i) {
-    if (!len_code[code_len[i]].empty()) {
-      throw std::runtime_error("Invalid len_code");
+void convert_tree::pair_table() {
+  constexpr std::size_t mask = (static_cast<std::size_t>(1) << DECODE_TABLE_BITS) - 1;
+  for (std::size_t index = 0; index <= mask; ++index) {
+    table_entry first = table[index];
+    if (entry_count(first) != 1) {
+      continue;
+    }
+    table_entry second = table[(index << entry_len(first)) & mask];
+    atom_char_t value = static_cast<atom_char_t>(entry_value(second));
+    std::size_t len = entry_len(first) + code_len[value];
+    if (entry_count(second) != 0 && len <= DECODE_TABLE_BITS) {
+      table[index] = make_entry(entry_value(first) | value << ATOM_CHAR_SIZE, len, 2);
     }
   }
 }
 
-atom_char_t convert_tree::decode(out_element& code_frag) {
-  auto el = decode_table.lower_bound(code_frag);
-  shift_out_element(el->first[LEN_INDEX_OUT_EL], code_frag);
-  return el->second;
+bool convert_tree::decode_one(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t& value) const {
+  std::size_t bit = pos, offset = 0, bits = primary_bits;
+  while (bit < end) {
+    out_char_t window = load_be64(data + bit / ATOM_CHAR_SIZE) << (bit % ATOM_CHAR_SIZE);
+    table_entry entry = table[offset + static_cast<std::size_t>(window >> (OUT_CHAR_SIZE - bits))];
+    if (entry_count(entry) != 0) {
+      value = static_cast<atom_char_t>(entry_value(entry));
+      if (end - pos < code_len[value]) {
+        return false;
+      }
+      pos += code_len[value];
+      return true;
+    }
+    bit += bits;
+    offset = sub_table_offset[link_index(entry)];
+    bits = link_bits(entry);
+  }
+  return false;
 }
 
-std::map<atom_char_t, out_element> convert_tree::get_encode_code_table(const std::vector<int_freq_t>& freq) {
-  std::priority_queue<std::pair<int_freq_t, base_node*>, std::vector<std::pair<int_freq_t, base_node*>>,
-                      convert_tree::freq_node_comparator>
-      freq_node;
-  try {
-    for (size_t el = 0; el != freq.size(); ++el) {
-      if (freq[el] != 0) {
-        freq_node.emplace(freq[el], new node(el));
+atom_char_t* convert_tree::decode(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                                  atom_char_t* out_end) const {
+  // a refilled window holds at least OUT_CHAR_SIZE - ATOM_CHAR_SIZE + 1 unread bits
+  constexpr std::size_t lookups = (OUT_CHAR_SIZE - ATOM_CHAR_SIZE + 1) / DECODE_TABLE_BITS;
+  const table_entry* primary = table.data();
+  std::size_t bit = pos;
+  while (bit + OUT_CHAR_SIZE <= end && out_end - out >= static_cast<std::ptrdiff_t>(2 * lookups + 1)) {
+    out_char_t window = load_be64(data + bit / ATOM_CHAR_SIZE) << (bit % ATOM_CHAR_SIZE);
+    std::size_t i = 0;
+    for (; i != lookups; ++i) {
+      table_entry entry = primary[window >> (OUT_CHAR_SIZE - DECODE_TABLE_BITS)];
+      if (entry_count(entry) == 0) {
+        break;
+      }
+      out[0] = static_cast<atom_char_t>(entry);
+      out[1] = static_cast<atom_char_t>(entry >> ATOM_CHAR_SIZE);
+      out += entry_count(entry);
+      window <<= entry_len(entry);
+      bit += entry_len(entry);
+    }
+    if (i != lookups && !decode_one(data, bit, end, *out++)) {
+      --out;
+      break;
+    }
+  }
+  while (out != out_end && decode_one(data, bit, end, *out)) {
+    ++out;
+  }
+  pos = bit;
+  return out;
+}
+
+atom_char_t* convert_tree::decode_unpadded(const unsigned char* data, std::size_t& pos, std::size_t end,
+                                           atom_char_t* out, atom_char_t* out_end) const {
+  std::size_t size = (end + ATOM_CHAR_SIZE - 1) / ATOM_CHAR_SIZE;
+  std::size_t safe_end = size > BUF_PADDING ? (size - BUF_PADDING) * ATOM_CHAR_SIZE : 0;
+  if (pos < safe_end) {
+    out = decode(data, pos, std::min(safe_end, end), out, out_end);
+    if (out == out_end) {
+      return out;
+    }
+  }
+  // the decoder stopped less than MAX_CODE_LEN bits before safe_end, so the rest fits into the padded copy
+  std::array<unsigned char, 4 * BUF_PADDING> tail{};
+  std::size_t skip = pos / ATOM_CHAR_SIZE;
+  std::copy(data + skip, data + size, tail.data());
+  std::size_t tail_pos = pos - skip * ATOM_CHAR_SIZE;
+  out = decode(tail.data(), tail_pos, end - skip * ATOM_CHAR_SIZE, out, out_end);
+  pos = tail_pos + skip * ATOM_CHAR_SIZE;
+  return out;
+}
+
+void convert_tree::decode_interleaved(const unsigned char* data,
+                                      std::array<bit_stream, INTERLEAVED_STREAMS>& streams) const {
+  static_assert(INTERLEAVED_STREAMS == 4);
+  constexpr std::size_t lookups = (OUT_CHAR_SIZE - ATOM_CHAR_SIZE + 1) / DECODE_TABLE_BITS;
+  const table_entry* primary = table.data();
+  // A link entry consumes nothing, so the stream stalls on it until decode_one takes the long code
+  auto lookup = [primary](out_char_t& window, atom_char_t*& out) {
+    table_entry entry = primary[window >> (OUT_CHAR_SIZE - DECODE_TABLE_BITS)];
+    out[0] = static_cast<atom_char_t>(entry);
+    out[1] = static_cast<atom_char_t>(entry >> ATOM_CHAR_SIZE);
+    out += entry_count(entry);
+    window <<= entry_len(entry);
+    return entry;
+  };
+  // The lowest bit of a refilled window is set and never reached by the lookups, so the bits consumed since
+  // the refill are its trailing zeros: positions are updated once per refill and the streams fit in registers.
+  auto refill = [data](std::size_t pos) {
+    return load_be64(data + pos / ATOM_CHAR_SIZE) << (pos % ATOM_CHAR_SIZE) | 1;
+  };
+  auto take_long = [this, data](table_entry entry, const bit_stream& stream, std::size_t& pos, atom_char_t*& out) {
+    if (entry_count(entry) != 0) {
+      return true;
+    }
+    if (!decode_one(data, pos, stream.end, *out)) {
+      return false;
+    }
+    ++out;
+    return true;
+  };
+  auto can_refill = [](std::size_t pos, const atom_char_t* out, const bit_stream& stream) {
+    return pos + OUT_CHAR_SIZE <= stream.end && stream.out_end - out >= static_cast<std::ptrdiff_t>(2 * lookups + 1);
+  };
+  // stores through the byte pointers could alias the streams, so their state lives in locals
+  std::size_t pos0 = streams[0].pos, pos1 = streams[1].pos, pos2 = streams[2].pos, pos3 = streams[3].pos;
+  atom_char_t *out0 = streams[0].out, *out1 = streams[1].out, *out2 = streams[2].out, *out3 = streams[3].out;
+  while (can_refill(pos0, out0, streams[0]) && can_refill(pos1, out1, streams[1]) &&
+         can_refill(pos2, out2, streams[2]) && can_refill(pos3, out3, streams[3])) {
+    out_char_t window0 = refill(pos0), window1 = refill(pos1), window2 = refill(pos2), window3 = refill(pos3);
+    table_entry entry0, entry1, entry2, entry3;
+    for (std::size_t i = 0; i != lookups; ++i) {
+      entry0 = lookup(window0, out0);
+      entry1 = lookup(window1, out1);
+      entry2 = lookup(window2, out2);
+      entry3 = lookup(window3, out3);
+    }
+    pos0 += count_trailing_zeros(window0);
+    pos1 += count_trailing_zeros(window1);
+    pos2 += count_trailing_zeros(window2);
+    pos3 += count_trailing_zeros(window3);
+    if (!take_long(entry0, streams[0], pos0, out0) || !take_long(entry1, streams[1], pos1, out1) ||
+        !take_long(entry2, streams[2], pos2, out2) || !take_long(entry3, streams[3], pos3, out3)) {
+      break;
+    }
+  }
+  streams[0].pos = pos0, streams[1].pos = pos1, streams[2].pos = pos2, streams[3].pos = pos3;
+  streams[0].out = out0, streams[1].out = out1, streams[2].out = out2, streams[3].out = out3;
+  for (bit_stream& stream : streams) {
+    stream.out = decode_unpadded(data, stream.pos, stream.end, stream.out, stream.out_end);
+  }
+}
+
+context_tree::context_tree(const std::array<atom_char_t, NUMBER_ATOM_CHARS>& groups,
+                           const std::vector<std::vector<atom_char_t>>& code_len) {
+  assign(groups, code_len);
+}
+
+void context_tree::assign(const std::array<atom_char_t, NUMBER_ATOM_CHARS>& groups,
+                          const std::vector<std::vector<atom_char_t>>& code_len) {
+  stage_timer timer(stage::tree);
+  for (atom_char_t group : groups) {
+    if (group >= code_len.size()) {
+      throw std::runtime_error("Invalid len_code");
+    }
+  }
+  if (trees.size() > code_len.size()) {
+    trees.erase(trees.begin() + code_len.size(), trees.end());
+  }
+  for (std::size_t group = 0; group != code_len.size(); ++group) {
+    if (group == trees.size()) {
+      trees.emplace_back(code_len[group], false);
+    }
+    trees[group].assign(code_len[group], false, CONTEXT_TABLE_BITS);
+  }
+  for (std::size_t context = 0; context != NUMBER_ATOM_CHARS; ++context) {
+    context_trees[context] = &trees[groups[context]];
+    primary[context] = trees[groups[context]].table.data();
+  }
+}
+
+atom_char_t* context_tree::decode(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                                  atom_char_t* out_end, atom_char_t& prev) const {
+  constexpr std::size_t lookups = (OUT_CHAR_SIZE - ATOM_CHAR_SIZE + 1) / CONTEXT_TABLE_BITS;
+  std::size_t bit = pos;
+  while (bit + OUT_CHAR_SIZE <= end && out_end - out > static_cast<std::ptrdiff_t>(lookups)) {
+    out_char_t window = load_be64(data + bit / ATOM_CHAR_SIZE) << (bit % ATOM_CHAR_SIZE);
+    std::size_t i = 0;
+    for (; i != lookups; ++i) {
+      convert_tree::table_entry entry = primary[prev][window >> (OUT_CHAR_SIZE - CONTEXT_TABLE_BITS)];
+      if (entry_count(entry) == 0) {
+        break;
       }
+      prev = *out++ = static_cast<atom_char_t>(entry);
+      window <<= entry_len(entry);
+      bit += entry_len(entry);
+    }
+    if (i != lookups) {
+      if (!context_trees[prev]->decode_one(data, bit, end, *out)) {
+        break;
+      }
+      prev = *out++;
+    }
+  }
+  while (out != out_end && context_trees[prev]->decode_one(data, bit, end, *out)) {
+    prev = *out++;
+  }
+  pos = bit;
+  return out;
+}
+
+atom_char_t* context_tree::decode_unpadded(const unsigned char* data, std::size_t& pos, std::size_t end,
+                                           atom_char_t* out, atom_char_t* out_end, atom_char_t& prev) const {
+  std::size_t size = (end + ATOM_CHAR_SIZE - 1) / ATOM_CHAR_SIZE;
+  std::size_t safe_end = size > BUF_PADDING ? (size - BUF_PADDING) * ATOM_CHAR_SIZE : 0;
+  if (pos < safe_end) {
+    out = decode(data, pos, std::min(safe_end, end), out, out_end, prev);
+    if (out == out_end) {
+      return out;
+    }
+  }
+  std::array<unsigned char, 4 * BUF_PADDING> tail{};
+  std::size_t skip = pos / ATOM_CHAR_SIZE;
+  std::copy(data + skip, data + size, tail.data());
+  std::size_t tail_pos = pos - skip * ATOM_CHAR_SIZE;
+  out = decode(tail.data(), tail_pos, end - skip * ATOM_CHAR_SIZE, out, out_end, prev);
+  pos = tail_pos + skip * ATOM_CHAR_SIZE;
+  return out;
+}
+
+atom_char_t* context_tree::decode_unpadded(const unsigned char* data, std::size_t& pos, std::size_t end,
+                                           atom_char_t* out, atom_char_t* out_end) const {
+  atom_char_t prev = 0;
+  return decode_unpadded(data, pos, end, out, out_end, prev);
+}
+
+void context_tree::decode_interleaved(const unsigned char* data,
+                                      std::array<bit_stream, INTERLEAVED_STREAMS>& streams) const {
+  static_assert(INTERLEAVED_STREAMS == 4);
+  constexpr std::size_t lookups = (OUT_CHAR_SIZE - ATOM_CHAR_SIZE + 1) / CONTEXT_TABLE_BITS;
+  // As in convert_tree::decode_interleaved a link entry stalls its stream, which keeps its context meanwhile
+  auto lookup = [this](out_char_t& window, atom_char_t*& out, atom_char_t& prev) {
+    convert_tree::table_entry entry = primary[prev][window >> (OUT_CHAR_SIZE - CONTEXT_TABLE_BITS)];
+    *out = static_cast<atom_char_t>(entry);
+    prev = entry_count(entry) != 0 ? *out : prev;
+    out += entry_count(entry);
+    window <<= entry_len(entry);
+    return entry;
+  };
+  auto refill = [data](std::size_t pos) {
+    return load_be64(data + pos / ATOM_CHAR_SIZE) << (pos % ATOM_CHAR_SIZE) | 1;
+  };
+  auto take_long = [this, data](convert_tree::table_entry entry, const bit_stream& stream, std::size_t& pos,
+                                atom_char_t*& out, atom_char_t& prev) {
+    if (entry_count(entry) != 0) {
+      return true;
     }
-    while (freq_node.size() > 1) {
-      auto p1 = freq_node.top();
-      freq_node.pop();
-      auto p2 = freq_node.top();
-      freq_node.pop();
-      freq_node.emplace(p1.first + p2.first, new base_node(p1.second, p2.second));
+    if (!context_trees[prev]->decode_one(data, pos, stream.end, *out)) {
+      return false;
     }
-  } catch (...) {
-    while (!freq_node.empty()) {
-      delete freq_node.top().second;
-      freq_node.pop();
+    prev = *out++;
+    return true;
+  };
+  auto can_refill = [](std::size_t pos, const atom_char_t* out, const bit_stream& stream) {
+    return pos + OUT_CHAR_SIZE <= stream.end && stream.out_end - out > static_cast<std::ptrdiff_t>(lookups);
+  };
+  std::size_t pos0 = streams[0].pos, pos1 = streams[1].pos, pos2 = streams[2].pos, pos3 = streams[3].pos;
+  atom_char_t *out0 = streams[0].out, *out1 = streams[1].out, *out2 = streams[2].out, *out3 = streams[3].out;
+  atom_char_t prev0 = 0, prev1 = 0, prev2 = 0, prev3 = 0;
+  while (can_refill(pos0, out0, streams[0]) && can_refill(pos1, out1, streams[1]) &&
+         can_refill(pos2, out2, streams[2]) && can_refill(pos3, out3, streams[3])) {
+    out_char_t window0 = refill(pos0), window1 = refill(pos1), window2 = refill(pos2), window3 = refill(pos3);
+    convert_tree::table_entry entry0, entry1, entry2, entry3;
+    for (std::size_t i = 0; i != lookups; ++i) {
+      entry0 = lookup(window0, out0, prev0);
+      entry1 = lookup(window1, out1, prev1);
+      entry2 = lookup(window2, out2, prev2);
+      entry3 = lookup(window3, out3, prev3);
     }
-    throw;
+    pos0 += count_trailing_zeros(window0);
+    pos1 += count_trailing_zeros(window1);
+    pos2 += count_trailing_zeros(window2);
+    pos3 += count_trailing_zeros(window3);
+    if (!take_long(entry0, streams[0], pos0, out0, prev0) || !take_long(entry1, streams[1], pos1, out1, prev1) ||
+        !take_long(entry2, streams[2], pos2, out2, prev2) || !take_long(entry3, streams[3], pos3, out3, prev3)) {
+      break;
+    }
+  }
+  streams[0].pos = pos0, streams[1].pos = pos1, streams[2].pos = pos2, streams[3].pos = pos3;
+  streams[0].out = out0, streams[1].out = out1, streams[2].out = out2, streams[3].out = out3;
+  std::array<atom_char_t, INTERLEAVED_STREAMS> prev = {prev0, prev1, prev2, prev3};
+  for (std::size_t k = 0; k != INTERLEAVED_STREAMS; ++k) {
+    streams[k].out = decode_unpadded(data, streams[k].pos, streams[k].end, streams[k].out, streams[k].out_end, prev[k]);
   }
-  if (freq_node.empty()) {
+}
+
+encode_table convert_tree::get_encode_table(const std::vector<int_freq_t>& freq) {
+  stage_timer timer(stage::tree);
+  if (freq.size() != NUMBER_ATOM_CHARS) {
     throw std::runtime_error("Invalid frequency");
   }
-  auto root = freq_node.top().second;
-  std::vector<std::set<atom_char_t>> len_code(NUMBER_ATOM_CHARS);
-  root->get_len_code(0, len_code);
-  delete root;
+  std::array<atom_char_t, NUMBER_ATOM_CHARS> order;
+  std::size_t count = 0;
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if (freq[el] != 0) {
+      order[count++] = static_cast<atom_char_t>(el);
+    }
+  }
+  if (count < 2) {
+    throw std::runtime_error("Invalid frequency");
+  }
+  std::sort(order.begin(), order.begin() + count, [&freq](atom_char_t a, atom_char_t b) {
+    return freq[a] < freq[b] || (freq[a] == freq[b] && a < b);
+  });
+  std::array<int_freq_t, NUMBER_ATOM_CHARS> weight;
+  for (std::size_t i = 0; i != count; ++i) {
+    weight[i] = freq[order[i]];
+  }
+  minimum_redundancy_len(weight.data(), count);
+
+  std::array<atom_char_t, NUMBER_ATOM_CHARS> code_len{};
+  if (weight[0] <= MAX_ENCODE_CODE_LEN) {
+    for (std::size_t i = 0; i != count; ++i) {
+      code_len[order[i]] = static_cast<atom_char_t>(weight[i]);
+    }
+  } else {
+    std::array<std::size_t, NUMBER_ATOM_CHARS> limited = limit_code_len(freq, MAX_ENCODE_CODE_LEN);
+    std::copy(limited.begin(), limited.end(), code_len.begin());
+  }
+  return canonical_table(code_len.data());
+}
+
+encode_table convert_tree::get_canonical_table(const std::vector<atom_char_t>& code_len) {
+  if (code_len.size() != NUMBER_ATOM_CHARS) {
+    throw std::runtime_error("Invalid len_code");
+  }
+  return canonical_table(code_len.data());
+}
+
+std::map<atom_char_t, out_element> convert_tree::get_encode_code_table(const std::vector<int_freq_t>& freq) {
   std::map<atom_char_t, out_element> code_table;
-  code_len_to_code_table({}, &code_table, nullptr, len_code);
+  encode_table table = get_encode_table(freq);
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    if (table[el].len != 0) {
+      out_element& out_el = code_table[el];
+      out_el[0] = static_cast<out_char_t>(table[el].code) << (OUT_CHAR_SIZE - table[el].len);
+      out_el[LEN_INDEX_OUT_EL] = table[el].len;
+    }
+  }
   return code_table;
 }
 } // namespace huffman
@@ -7,46 +7,104 @@
 
 #include "../utils/constants.h"
 
-#include <queue>
-
+#include <array>
 #include <map>
-#include <set>
 #include <vector>
 
 namespace huffman {
+// Bits [pos, end) of a buffer holding several MSB-first bit streams, decoded into [out, out_end)
+struct bit_stream {
+  std::size_t pos;
+  std::size_t end;
+  atom_char_t* out;
+  atom_char_t* out_end;
+};
+
 class convert_tree {
 private:
-  class base_node {
-  public:
-    base_node(base_node* left, base_node* right);
-    virtual ~base_node();
+  friend class context_tree;
+
+  // Decode table entries are packed as | count:8 | len:8 | value:16 |. Leaf entries hold one or two symbols
+  // in `value` and the number of bits they take, link entries (count == 0) hold the index of a sub-table
+  // and the number of bits it is indexed by in `value`.
+  using table_entry = uint32_t;
+
+public:
+  // Pairing short codes into one table entry speeds up decoding, but takes longer than decoding a few KiB
+  explicit convert_tree(const std::vector<atom_char_t>& code_len, bool pair_symbols = true);
+
+  // Rebuilds the tables for other code lengths reusing their memory, the tree is unchanged if they are invalid
+  void assign(const std::vector<atom_char_t>& code_len, bool pair_symbols = true);
 
-    bool is_leaf() const;
-    void get_len_code(std::size_t actual_len, std::vector<std::set<atom_char_t>>& len_code);
+  // Decodes symbols from the MSB-first bit stream `data` starting at bit `pos` into [out, out_end).
+  // Stops when the output is full or the next code does not fit before bit `end`; `pos` is advanced past
+  // the decoded codes. `data` must stay readable for BUF_PADDING bytes past bit `end`.
+  atom_char_t* decode(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                      atom_char_t* out_end) const;
+  // Same as decode, but reads only the bytes holding the bits before `end`, so `data` needs no padding
+  atom_char_t* decode_unpadded(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                               atom_char_t* out_end) const;
+  // Decodes every stream like decode_unpadded. The lookups of different streams don't depend on each other,
+  // so interleaving them hides the latency of the table loads that chains a single stream.
+  void decode_interleaved(const unsigned char* data, std::array<bit_stream, INTERLEAVED_STREAMS>& streams) const;
+  // Canonical codes not longer than MAX_ENCODE_CODE_LEN bits, at least two frequencies must be nonzero.
+  // Huffman codes are used as they are when they fit, otherwise the lengths are limited by package-merge.
+  static encode_table get_encode_table(const std::vector<int_freq_t>& freq);
+  // Canonical codes for lengths not longer than MAX_ENCODE_CODE_LEN, longer ones get no code
+  static encode_table get_canonical_table(const std::vector<atom_char_t>& code_len);
+  static std::map<atom_char_t, out_element> get_encode_code_table(const std::vector<int_freq_t>& freq);
 
-  private:
-    base_node* left;
-    base_node* right;
-  };
+private:
+  // Primary tables of `table_bits` bits, decode and decode_interleaved need DECODE_TABLE_BITS
+  void assign(const std::vector<atom_char_t>& code_len, bool pair_symbols, std::size_t table_bits);
+  void fill_table(std::size_t offset, std::size_t bits, std::size_t max_len, out_char_t code, std::size_t len,
+                  atom_char_t value);
+  void pair_table();
+  bool decode_one(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t& value) const;
 
-  class node : public base_node {
-  public:
-    explicit node(atom_char_t value);
-    ~node();
+private:
+  std::vector<atom_char_t> code_len;
+  std::vector<table_entry> table;
+  std::vector<std::size_t> sub_table_offset;
+  std::size_t primary_bits = DECODE_TABLE_BITS;
+};
 
-  public:
-    atom_char_t value;
-  };
+// Bits of the primary tables of context trees, smaller than DECODE_TABLE_BITS so the tables of all groups fit
+// into the L1 cache together
+constexpr std::size_t CONTEXT_TABLE_BITS = 9;
 
+// Order-1 decoding tables: every byte is decoded with the tree of the group its preceding byte is mapped to.
+// The trees don't pair symbols, the second symbol of a pair would need the tree the first one selects.
+class context_tree {
 public:
-  explicit convert_tree(std::vector<atom_char_t> code_len);
+  // `groups` maps a preceding byte to the index of its code lengths in `code_len`
+  context_tree(const std::array<atom_char_t, NUMBER_ATOM_CHARS>& groups,
+               const std::vector<std::vector<atom_char_t>>& code_len);
+  context_tree(const context_tree&) = delete;
+  context_tree(context_tree&&) = default;
+  context_tree& operator=(const context_tree&) = delete;
+  context_tree& operator=(context_tree&&) = default;
 
-  atom_char_t decode(out_element& code_frag);
-  static std::map<atom_char_t, out_element> get_encode_code_table(const std::vector<int_freq_t>& freq);
+  // Rebuilds the tables reusing the memory of the trees
+  void assign(const std::array<atom_char_t, NUMBER_ATOM_CHARS>& groups,
+              const std::vector<std::vector<atom_char_t>>& code_len);
+
+  // Decodes like convert_tree::decode_unpadded, the first symbol follows a zero byte
+  atom_char_t* decode_unpadded(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                               atom_char_t* out_end) const;
+  // Decodes every stream like decode_unpadded, interleaving the lookups of different streams
+  void decode_interleaved(const unsigned char* data, std::array<bit_stream, INTERLEAVED_STREAMS>& streams) const;
 
 private:
-  class freq_node_comparator;
-  std::map<out_element, atom_char_t, std::greater<>> decode_table;
+  atom_char_t* decode(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                      atom_char_t* out_end, atom_char_t& prev) const;
+  atom_char_t* decode_unpadded(const unsigned char* data, std::size_t& pos, std::size_t end, atom_char_t* out,
+                               atom_char_t* out_end, atom_char_t& prev) const;
+
+  std::vector<convert_tree> trees;
+  // the tree of every preceding byte and its primary table, so a lookup doesn't go through the tree
+  std::array<const convert_tree*, NUMBER_ATOM_CHARS> context_trees{};
+  std::array<const convert_tree::table_entry*, NUMBER_ATOM_CHARS> primary{};
 };
 } // namespace huffman
 #endif // HUFFMAN_CONVERT_TREE_H
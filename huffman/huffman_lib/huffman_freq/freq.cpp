@@ -0,0 +1,208 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "freq.h"
+
+#include "../utils/stats.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace huffman {
+namespace {
+// Runs of equal bytes make consecutive increments of one counter wait for each other through the store buffer.
+// Spreading the bytes of every word over independent banks breaks that chain.
+constexpr std::size_t FREQ_BANKS = 8;
+// Bank counters are 32-bit, so they are merged before FREQ_CHUNK_SIZE / FREQ_BANKS could overflow them
+constexpr std::size_t FREQ_CHUNK_SIZE = std::size_t(1) << 31;
+// Below this size clearing and merging the banks costs more than it saves
+constexpr std::size_t FREQ_BANKS_MIN_SIZE = 4096;
+
+using freq_bank = std::array<uint32_t, NUMBER_ATOM_CHARS>;
+
+// Reassignments of the contexts to the nearest group, few contexts move after the first ones
+constexpr std::size_t CLUSTER_ITERATIONS = 4;
+// Added to every count when group costs are estimated, so a byte a group hasn't seen yet isn't infinitely expensive
+constexpr double UNSEEN_WEIGHT = 0.5;
+
+struct pair_count {
+  atom_char_t byte;
+  int_freq_t count;
+};
+
+// Bits of every byte coded with a code fitted to `freq`
+using cost_table = std::array<double, NUMBER_ATOM_CHARS>;
+
+cost_table make_cost(const std::vector<int_freq_t>& freq) {
+  double total = std::accumulate(freq.begin(), freq.end(), 0.0);
+  double log_total = std::log2(total + UNSEEN_WEIGHT * NUMBER_ATOM_CHARS);
+  cost_table cost;
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    cost[el] = log_total - std::log2(static_cast<double>(freq[el]) + UNSEEN_WEIGHT);
+  }
+  return cost;
+}
+
+double coded_bits(const std::vector<pair_count>& followers, const cost_table& cost) {
+  double bits = 0;
+  for (const pair_count& el : followers) {
+    bits += static_cast<double>(el.count) * cost[el.byte];
+  }
+  return bits;
+}
+} // namespace
+
+void count_freq(const atom_char_t* data, std::size_t size, std::vector<int_freq_t>& freq) {
+  stage_timer timer(stage::freq, size);
+  if (size < FREQ_BANKS_MIN_SIZE) {
+    for (std::size_t i = 0; i != size; ++i) {
+      freq[data[i]]++;
+    }
+    return;
+  }
+  std::array<freq_bank, FREQ_BANKS> banks;
+  while (size != 0) {
+    std::size_t chunk = std::min(size, FREQ_CHUNK_SIZE);
+    for (auto& bank : banks) {
+      bank.fill(0);
+    }
+    std::size_t i = 0;
+    for (; i + sizeof(out_char_t) <= chunk; i += sizeof(out_char_t)) {
+      out_char_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      for (std::size_t byte = 0; byte != sizeof(out_char_t); ++byte) {
+        banks[byte % FREQ_BANKS][static_cast<atom_char_t>(word >> (byte * ATOM_CHAR_SIZE))]++;
+      }
+    }
+    for (; i != chunk; ++i) {
+      banks[0][data[i]]++;
+    }
+    for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+      for (const auto& bank : banks) {
+        freq[el] += bank[el];
+      }
+    }
+    data += chunk;
+    size -= chunk;
+  }
+}
+
+void complete_freq(std::vector<int_freq_t>& freq) {
+  std::size_t count_dif = 0;
+  for (int_freq_t el : freq) {
+    count_dif += el != 0;
+  }
+  for (std::size_t i = 0; count_dif <= 1; ++i) {
+    if (freq[i] == 0) {
+      freq[i]++;
+      count_dif++;
+    }
+  }
+}
+
+void count_pair_freq(const atom_char_t* data, std::size_t size, atom_char_t prev, std::vector<int_freq_t>& pair_freq) {
+  stage_timer timer(stage::freq, size);
+  for (std::size_t i = 0; i != size; ++i) {
+    pair_freq[prev * NUMBER_ATOM_CHARS + data[i]]++;
+    prev = data[i];
+  }
+}
+
+// Seeds the groups farthest first: the most frequent context, then always the context coded with the most bits in
+// excess of its own statistics by its nearest seed. Then moves every context to the group coding its bytes in the
+// fewest bits, like k-means with the cross entropy as the distance.
+std::array<atom_char_t, NUMBER_ATOM_CHARS> cluster_contexts(const std::vector<int_freq_t>& pair_freq,
+                                                           std::size_t max_groups) {
+  stage_timer timer(stage::tree);
+  std::vector<std::vector<pair_count>> followers(NUMBER_ATOM_CHARS);
+  std::vector<std::size_t> contexts;
+  std::vector<int_freq_t> totals(NUMBER_ATOM_CHARS);
+  for (std::size_t context = 0; context != NUMBER_ATOM_CHARS; ++context) {
+    for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+      if (int_freq_t count = pair_freq[context * NUMBER_ATOM_CHARS + el]) {
+        followers[context].push_back({static_cast<atom_char_t>(el), count});
+        totals[context] += count;
+      }
+    }
+    if (totals[context] != 0) {
+      contexts.push_back(context);
+    }
+  }
+  std::array<atom_char_t, NUMBER_ATOM_CHARS> groups{};
+  if (contexts.empty()) {
+    return groups;
+  }
+  std::stable_sort(contexts.begin(), contexts.end(),
+                   [&totals](std::size_t a, std::size_t b) { return totals[a] > totals[b]; });
+
+  std::vector<std::vector<int_freq_t>> group_freq;
+  std::vector<cost_table> cost;
+  std::vector<double> own_bits(NUMBER_ATOM_CHARS);
+  std::vector<double> excess(NUMBER_ATOM_CHARS, std::numeric_limits<double>::infinity());
+  for (std::size_t context : contexts) {
+    std::vector<int_freq_t> freq(NUMBER_ATOM_CHARS);
+    for (const pair_count& el : followers[context]) {
+      freq[el.byte] = el.count;
+    }
+    cost_table own = make_cost(freq);
+    own_bits[context] = coded_bits(followers[context], own);
+  }
+  for (std::size_t seed = contexts[0]; group_freq.size() != max_groups;) {
+    group_freq.emplace_back(NUMBER_ATOM_CHARS);
+    for (const pair_count& el : followers[seed]) {
+      group_freq.back()[el.byte] = el.count;
+    }
+    cost.push_back(make_cost(group_freq.back()));
+    for (std::size_t context : contexts) {
+      excess[context] = std::min(excess[context], coded_bits(followers[context], cost.back()) - own_bits[context]);
+    }
+    // the first of the farthest contexts, so ties go to the more frequent one
+    seed = *std::max_element(contexts.begin(), contexts.end(),
+                             [&excess](std::size_t a, std::size_t b) { return excess[a] < excess[b]; });
+    if (excess[seed] <= 0) {
+      break;
+    }
+  }
+
+  std::size_t count = group_freq.size();
+  for (std::size_t iteration = 0; iteration != CLUSTER_ITERATIONS && count > 1; ++iteration) {
+    if (iteration != 0) {
+      for (std::size_t group = 0; group != count; ++group) {
+        cost[group] = make_cost(group_freq[group]);
+      }
+    }
+    for (std::size_t context : contexts) {
+      double best_bits = 0;
+      for (std::size_t group = 0; group != count; ++group) {
+        double bits = coded_bits(followers[context], cost[group]);
+        if (group == 0 || bits < best_bits) {
+          best_bits = bits;
+          groups[context] = static_cast<atom_char_t>(group);
+        }
+      }
+    }
+    // groups left without contexts are dropped, the others are renumbered in order
+    std::vector<std::size_t> renumber(count, count);
+    std::size_t used = 0;
+    for (std::size_t context : contexts) {
+      if (renumber[groups[context]] == count) {
+        renumber[groups[context]] = used++;
+      }
+    }
+    count = used;
+    group_freq.assign(count, std::vector<int_freq_t>(NUMBER_ATOM_CHARS));
+    for (std::size_t context : contexts) {
+      groups[context] = static_cast<atom_char_t>(renumber[groups[context]]);
+      for (const pair_count& el : followers[context]) {
+        group_freq[groups[context]][el.byte] += el.count;
+      }
+    }
+  }
+  return groups;
+}
+} // namespace huffman
@@ -0,0 +1,26 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_FREQ_H
+#define HUFFMAN_FREQ_H
+
+#include "../utils/constants.h"
+
+#include <array>
+#include <vector>
+
+namespace huffman {
+// Adds occurrences of every byte of [data, data + size) to `freq`
+void count_freq(const atom_char_t* data, std::size_t size, std::vector<int_freq_t>& freq);
+// A Huffman tree needs at least two leaves, so fake symbols are added to degenerate frequencies
+void complete_freq(std::vector<int_freq_t>& freq);
+// Adds occurrences of every pair of consecutive bytes of [data, data + size) to
+// `pair_freq[prev * NUMBER_ATOM_CHARS + byte]`, the first byte follows `prev`
+void count_pair_freq(const atom_char_t* data, std::size_t size, atom_char_t prev, std::vector<int_freq_t>& pair_freq);
+// Maps the preceding bytes of `pair_freq` to at most `max_groups` groups of contexts followed by similar bytes,
+// so the bytes of a group can share one code. Contexts without pairs are mapped to group 0.
+std::array<atom_char_t, NUMBER_ATOM_CHARS> cluster_contexts(const std::vector<int_freq_t>& pair_freq,
+                                                           std::size_t max_groups);
+} // namespace huffman
+#endif // HUFFMAN_FREQ_H
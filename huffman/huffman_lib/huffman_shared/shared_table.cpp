@@ -0,0 +1,92 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "shared_table.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace huffman {
+namespace {
+constexpr uint32_t FNV_OFFSET = 2166136261u;
+constexpr uint32_t FNV_PRIME = 16777619u;
+
+std::vector<atom_char_t> complete_code_len(std::vector<int_freq_t> freq) {
+  if (freq.size() != NUMBER_ATOM_CHARS) {
+    throw std::runtime_error("Invalid frequency");
+  }
+  for (int_freq_t& el : freq) {
+    el = std::max<int_freq_t>(el, 1);
+  }
+  encode_table codes = convert_tree::get_encode_table(freq);
+  std::vector<atom_char_t> lens(NUMBER_ATOM_CHARS);
+  for (std::size_t el = 0; el != NUMBER_ATOM_CHARS; ++el) {
+    lens[el] = codes[el].len;
+  }
+  return lens;
+}
+
+// Checked before the tree is built: the encoder needs a code of at most MAX_ENCODE_CODE_LEN bits for every byte
+const std::vector<atom_char_t>& check_code_len(const std::vector<atom_char_t>& code_len) {
+  for (atom_char_t len : code_len) {
+    if (len == 0 || len > MAX_ENCODE_CODE_LEN) {
+      throw std::runtime_error("Broken table");
+    }
+  }
+  return code_len;
+}
+} // namespace
+
+shared_table::shared_table(std::vector<int_freq_t> freq) : shared_table(complete_code_len(std::move(freq))) {}
+
+shared_table::shared_table(const std::vector<atom_char_t>& code_len)
+    : lens(check_code_len(code_len)),
+      codes(convert_tree::get_canonical_table(lens)),
+      tree(lens),
+      table_id(FNV_OFFSET) {
+  for (atom_char_t len : lens) {
+    table_id = (table_id ^ len) * FNV_PRIME;
+  }
+}
+
+shared_table shared_table::load(std::istream& in) {
+  std::array<unsigned char, TABLE_MAGIC.size()> magic{};
+  std::vector<atom_char_t> code_len(NUMBER_ATOM_CHARS);
+  in.read(reinterpret_cast<char*>(magic.data()), magic.size());
+  in.read(reinterpret_cast<char*>(code_len.data()), code_len.size());
+  if (in.fail() || magic != TABLE_MAGIC) {
+    throw std::runtime_error("Broken table");
+  }
+  try {
+    return shared_table(code_len);
+  } catch (std::runtime_error&) {
+    throw std::runtime_error("Broken table");
+  }
+}
+
+void shared_table::save(std::ostream& out) const {
+  out.write(reinterpret_cast<const char*>(TABLE_MAGIC.data()), TABLE_MAGIC.size());
+  out.write(reinterpret_cast<const char*>(lens.data()), lens.size());
+  if (out.fail()) {
+    throw std::runtime_error("Writing error");
+  }
+}
+
+uint32_t shared_table::id() const {
+  return table_id;
+}
+
+const encode_table& shared_table::encoding() const {
+  return codes;
+}
+
+const convert_tree& shared_table::decoding() const {
+  return tree;
+}
+
+const std::vector<atom_char_t>& shared_table::code_len() const {
+  return lens;
+}
+} // namespace huffman
@@ -0,0 +1,47 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_SHARED_TABLE_H
+#define HUFFMAN_SHARED_TABLE_H
+
+#include "../huffman_convert_tree/convert_tree.h"
+#include "../utils/constants.h"
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace huffman {
+// Table files start with the magic followed by the code lengths of all bytes
+constexpr std::array<unsigned char, 4> TABLE_MAGIC = {'H', 'U', 'T', 1};
+
+// Code table agreed on in advance by both sides, so small messages don't carry their own code lengths.
+// Blocks coded with it carry the table id instead, a block is never decoded with a table it wasn't coded with.
+class shared_table {
+public:
+  // Every byte gets a code, also the ones missing from `freq`
+  explicit shared_table(std::vector<int_freq_t> freq);
+
+  // Reads a table written by save, throws if it is broken
+  static shared_table load(std::istream& in);
+  void save(std::ostream& out) const;
+
+  // Hash of the code lengths, which define the canonical codes
+  uint32_t id() const;
+  const encode_table& encoding() const;
+  const convert_tree& decoding() const;
+  const std::vector<atom_char_t>& code_len() const;
+
+private:
+  explicit shared_table(const std::vector<atom_char_t>& code_len);
+
+  std::vector<atom_char_t> lens;
+  encode_table codes;
+  convert_tree tree;
+  uint32_t table_id;
+};
+} // namespace huffman
+#endif // HUFFMAN_SHARED_TABLE_H
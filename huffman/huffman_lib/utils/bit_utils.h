@@ -0,0 +1,74 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_BIT_UTILS_H
+#define HUFFMAN_BIT_UTILS_H
+
+#include "constants.h"
+
+#include <cstring>
+
+namespace huffman {
+// Bit streams are stored MSB first, so 64-bit windows are read and written in big-endian byte order.
+inline out_char_t load_be64(const unsigned char* ptr) {
+  out_char_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap64(value);
+#elif defined(__GNUC__)
+  return value;
+#else
+  out_char_t result = 0;
+  for (std::size_t i = 0; i != sizeof(value); ++i) {
+    result = (result << ATOM_CHAR_SIZE) | ptr[i];
+  }
+  return result;
+#endif
+}
+
+// Checksums read little-endian words, so they don't depend on the platform either
+inline uint64_t load_le64(const unsigned char* ptr) {
+  uint64_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap64(value);
+#elif defined(__GNUC__)
+  return value;
+#else
+  uint64_t result = 0;
+  for (std::size_t i = sizeof(value); i != 0; --i) {
+    result = (result << ATOM_CHAR_SIZE) | ptr[i - 1];
+  }
+  return result;
+#endif
+}
+
+inline void store_be64(unsigned char* ptr, out_char_t value) {
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  value = __builtin_bswap64(value);
+  std::memcpy(ptr, &value, sizeof(value));
+#elif defined(__GNUC__)
+  std::memcpy(ptr, &value, sizeof(value));
+#else
+  for (std::size_t i = sizeof(value); i != 0; --i) {
+    ptr[i - 1] = static_cast<unsigned char>(value);
+    value >>= ATOM_CHAR_SIZE;
+  }
+#endif
+}
+
+// `value` must not be 0
+inline std::size_t count_trailing_zeros(out_char_t value) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(value);
+#else
+  std::size_t count = 0;
+  for (; (value & 1) == 0; value >>= 1) {
+    count++;
+  }
+  return count;
+#endif
+}
+} // namespace huffman
+#endif // HUFFMAN_BIT_UTILS_H
@@ -0,0 +1,71 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "checksum.h"
+
+#include "bit_utils.h"
+
+namespace huffman {
+namespace {
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+constexpr uint64_t rotl(uint64_t value, int shift) {
+  return value << shift | value >> (64 - shift);
+}
+
+uint64_t read_le32(const unsigned char* data) {
+  return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint64_t>(data[3]) << 24;
+}
+
+uint64_t round(uint64_t acc, uint64_t input) {
+  return rotl(acc + input * PRIME2, 31) * PRIME1;
+}
+
+uint64_t merge_round(uint64_t acc, uint64_t value) {
+  return (acc ^ round(0, value)) * PRIME1 + PRIME4;
+}
+} // namespace
+
+uint64_t xxhash64(const unsigned char* data, std::size_t size, uint64_t seed) {
+  const unsigned char* end = data + size;
+  uint64_t hash;
+  if (size >= 32) {
+    uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2, v3 = seed, v4 = seed - PRIME1;
+    for (; end - data >= 32; data += 32) {
+      v1 = round(v1, load_le64(data));
+      v2 = round(v2, load_le64(data + 8));
+      v3 = round(v3, load_le64(data + 16));
+      v4 = round(v4, load_le64(data + 24));
+    }
+    hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    hash = merge_round(hash, v1);
+    hash = merge_round(hash, v2);
+    hash = merge_round(hash, v3);
+    hash = merge_round(hash, v4);
+  } else {
+    hash = seed + PRIME5;
+  }
+  hash += size;
+  for (; end - data >= 8; data += 8) {
+    hash = rotl(hash ^ round(0, load_le64(data)), 27) * PRIME1 + PRIME4;
+  }
+  if (end - data >= 4) {
+    hash = rotl(hash ^ read_le32(data) * PRIME1, 23) * PRIME2 + PRIME3;
+    data += 4;
+  }
+  for (; data != end; ++data) {
+    hash = rotl(hash ^ *data * PRIME5, 11) * PRIME1;
+  }
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+  return hash;
+}
+} // namespace huffman
@@ -0,0 +1,16 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_CHECKSUM_H
+#define HUFFMAN_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace huffman {
+// XXH64 of [data, data + size): four independent multiply-rotate lanes, several bytes per cycle,
+// so checking the decoded blocks costs little next to decoding them
+uint64_t xxhash64(const unsigned char* data, std::size_t size, uint64_t seed = 0);
+} // namespace huffman
+#endif // HUFFMAN_CHECKSUM_H
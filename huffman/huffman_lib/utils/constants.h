@@ -20,6 +20,12 @@ using int_freq_t = uint64_t;
 using out_element = std::array<out_char_t, NUMBER_OUT_CHAR_IN_OUT_ELEMENT + 1>;
 using tail_out = std::pair<out_char_t, std::size_t>;
 
+// Code of a symbol right-aligned in `code`, symbols with len == 0 don't occur
+struct encode_code {
+  uint32_t code;
+  atom_char_t len;
+};
+
 constexpr std::size_t MAX_ATOM_CHAR = std::numeric_limits<atom_char_t>::max();
 constexpr std::size_t MAX_OUT_CHAR = std::numeric_limits<out_char_t>::max();
 constexpr std::size_t NUMBER_ATOM_CHARS = MAX_ATOM_CHAR + 1;
@@ -28,20 +34,19 @@ constexpr std::size_t ATOM_CHAR_SIZE = std::numeric_limits<atom_char_t>::digits;
 constexpr std::size_t BUF_SIZE = 32768;
 constexpr std::size_t CHAR_SIZE = std::numeric_limits<char>::digits + 1;
 constexpr std::size_t ATOM_CHAR_TO_OUT_FACTOR = (MAX_OUT_CHAR >> ATOM_CHAR_SIZE) + 1;
+constexpr std::size_t MAX_CODE_LEN = OUT_CHAR_SIZE - 1;
+constexpr std::size_t MAX_ENCODE_CODE_LEN = 32;
+constexpr std::size_t DECODE_TABLE_BITS = 11;
+// Large blocks are split into this many bit streams, which are decoded in parallel by one thread
+constexpr std::size_t INTERLEAVED_STREAMS = 4;
+constexpr std::size_t BUF_PADDING = 2 * sizeof(out_char_t);
+constexpr std::size_t BLOCK_SIZE = 1 << 20;
+constexpr std::size_t MAX_BLOCK_SIZE = 1 << 30;
+// Payload bytes of the single-table format decoded by one thread, see decode_options::threads
+constexpr std::size_t SYNC_CHUNK_SIZE = 1 << 18;
+// Bit positions of this many symbols are kept at the start of a chunk to find where its true decoding joins in
+constexpr std::size_t SYNC_SYMBOLS = 1024;
 
-static void shift_out_element(std::size_t shift, out_element& el) {
-  el[4] -= shift;
-  for (std::size_t i = 0; i != 4; ++i) {
-    if (i + shift / OUT_CHAR_SIZE < 4) {
-      el[i] = el[i + shift / OUT_CHAR_SIZE];
-      if (i > 0 && (shift % OUT_CHAR_SIZE) != 0) {
-        el[i - 1] += el[i] >> (OUT_CHAR_SIZE - (shift % OUT_CHAR_SIZE));
-      }
-      el[i] <<= shift % OUT_CHAR_SIZE;
-    } else {
-      el[i] = 0;
-    }
-  }
-}
+using encode_table = std::array<encode_code, NUMBER_ATOM_CHARS>;
 } // namespace huffman
 #endif // HUFFMAN_CONSTANTS_H
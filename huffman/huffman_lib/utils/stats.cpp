@@ -0,0 +1,114 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "stats.h"
+
+#include <atomic>
+#include <iomanip>
+
+namespace huffman {
+namespace {
+constexpr std::array<const char*, NUMBER_STAGES> STAGE_NAMES = {"read",   "freq",     "tree", "encode",
+                                                                 "decode", "checksum", "write"};
+
+struct atomic_stage {
+  std::atomic<uint64_t> nanoseconds{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> calls{0};
+};
+
+// Relaxed: the counters are only summed, and read after the threads adding to them are joined
+std::array<atomic_stage, NUMBER_STAGES> stage_totals;
+std::atomic<uint64_t> total_in{0};
+std::atomic<uint64_t> total_out{0};
+std::atomic<uint64_t> total_symbols{0};
+std::atomic<uint64_t> total_code_bits{0};
+
+void add(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t load(const std::atomic<uint64_t>& counter) {
+  return counter.load(std::memory_order_relaxed);
+}
+
+// MB/s of `bytes` processed in `nanoseconds`, 0 for stages that took no measurable time
+double megabytes_per_second(uint64_t bytes, uint64_t nanoseconds) {
+  return nanoseconds != 0 ? static_cast<double>(bytes) * 1000 / static_cast<double>(nanoseconds) : 0;
+}
+
+double average_code_len(const stats_snapshot& snapshot) {
+  return snapshot.symbols != 0 ? static_cast<double>(snapshot.code_bits) / static_cast<double>(snapshot.symbols) : 0;
+}
+} // namespace
+
+void stats::record(stage s, std::chrono::steady_clock::duration time, std::size_t bytes) {
+  atomic_stage& totals = stage_totals[static_cast<std::size_t>(s)];
+  add(totals.nanoseconds, std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+  add(totals.bytes, bytes);
+  add(totals.calls, 1);
+}
+
+void stats::count_io(std::size_t bytes_in, std::size_t bytes_out) {
+  add(total_in, bytes_in);
+  add(total_out, bytes_out);
+}
+
+void stats::count_symbols(std::size_t symbols, std::size_t code_bits) {
+  add(total_symbols, symbols);
+  add(total_code_bits, code_bits);
+}
+
+stats_snapshot stats::snapshot() {
+  stats_snapshot snapshot;
+  for (std::size_t i = 0; i != NUMBER_STAGES; ++i) {
+    snapshot.stages[i] = {load(stage_totals[i].nanoseconds), load(stage_totals[i].bytes),
+                          load(stage_totals[i].calls)};
+  }
+  snapshot.bytes_in = load(total_in);
+  snapshot.bytes_out = load(total_out);
+  snapshot.symbols = load(total_symbols);
+  snapshot.code_bits = load(total_code_bits);
+  return snapshot;
+}
+
+void stats::reset() {
+  for (atomic_stage& totals : stage_totals) {
+    totals.nanoseconds = totals.bytes = totals.calls = 0;
+  }
+  total_in = total_out = total_symbols = total_code_bits = 0;
+}
+
+void stats::write(std::ostream& out, const stats_snapshot& snapshot, bool json) {
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(3);
+  if (json) {
+    out << "{\"stages\":{";
+    for (std::size_t i = 0; i != NUMBER_STAGES; ++i) {
+      const stage_stats& s = snapshot.stages[i];
+      out << (i != 0 ? "," : "") << '"' << STAGE_NAMES[i] << "\":{\"ms\":" << s.nanoseconds / 1e6
+          << ",\"bytes\":" << s.bytes << ",\"calls\":" << s.calls
+          << ",\"mb_per_s\":" << megabytes_per_second(s.bytes, s.nanoseconds) << '}';
+    }
+    out << "},\"bytes_in\":" << snapshot.bytes_in << ",\"bytes_out\":" << snapshot.bytes_out
+        << ",\"symbols\":" << snapshot.symbols << ",\"average_code_len\":" << average_code_len(snapshot)
+        << ",\"buffer_refills\":" << snapshot.stages[static_cast<std::size_t>(stage::read)].calls << "}\n";
+  } else {
+    out << std::left << std::setw(10) << "stage" << std::right << std::setw(12) << "ms" << std::setw(16) << "bytes"
+        << std::setw(10) << "calls" << std::setw(12) << "MB/s" << '\n';
+    for (std::size_t i = 0; i != NUMBER_STAGES; ++i) {
+      const stage_stats& s = snapshot.stages[i];
+      out << std::left << std::setw(10) << STAGE_NAMES[i] << std::right << std::setw(12) << s.nanoseconds / 1e6
+          << std::setw(16) << s.bytes << std::setw(10) << s.calls << std::setw(12)
+          << megabytes_per_second(s.bytes, s.nanoseconds) << '\n';
+    }
+    out << "bytes in:            " << snapshot.bytes_in << '\n'
+        << "bytes out:           " << snapshot.bytes_out << '\n'
+        << "symbols:             " << snapshot.symbols << '\n'
+        << "average code length: " << average_code_len(snapshot) << " bits\n"
+        << "buffer refills:      " << snapshot.stages[static_cast<std::size_t>(stage::read)].calls << '\n';
+  }
+  out.flags(flags);
+}
+} // namespace huffman
@@ -0,0 +1,112 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_STATS_H
+#define HUFFMAN_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Built with -DHUFFMAN_STATS=0 the timers and counters compile to nothing, otherwise they cost a branch until
+// stats::enable turns them on
+#ifndef HUFFMAN_STATS
+#define HUFFMAN_STATS 1
+#endif
+
+namespace huffman {
+constexpr bool STATS_ENABLED = HUFFMAN_STATS != 0;
+
+// Stages of coding that are timed, in the order they are reported
+enum class stage : std::size_t { read, freq, tree, encode, decode, checksum, write };
+constexpr std::size_t NUMBER_STAGES = 7;
+
+struct stage_stats {
+  uint64_t nanoseconds = 0;
+  uint64_t bytes = 0;
+  // buffer refills for reading, tables for building trees, blocks or chunks otherwise
+  uint64_t calls = 0;
+};
+
+// Totals of all threads since the last reset. The time of a stage is summed over the threads running it,
+// so with several threads the stages may add up to more than the wall time.
+struct stats_snapshot {
+  std::array<stage_stats, NUMBER_STAGES> stages{};
+  // input and output of the coder, also when they are mapped files or memory
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  // symbols coded with Huffman codes and the bits of their codes
+  uint64_t symbols = 0;
+  uint64_t code_bits = 0;
+};
+
+class stats {
+public:
+  static void enable(bool on) {
+    collecting.store(on, std::memory_order_relaxed);
+  }
+
+  static bool enabled() {
+    return STATS_ENABLED && collecting.load(std::memory_order_relaxed);
+  }
+
+  static void record(stage s, std::chrono::steady_clock::duration time, std::size_t bytes);
+  static void count_io(std::size_t bytes_in, std::size_t bytes_out);
+  static void count_symbols(std::size_t symbols, std::size_t code_bits);
+
+  static stats_snapshot snapshot();
+  static void reset();
+  // Throughput of every stage and the counters, as aligned text or as a JSON object
+  static void write(std::ostream& out, const stats_snapshot& snapshot, bool json = false);
+
+private:
+  static inline std::atomic<bool> collecting{false};
+};
+
+// Adds the time from construction to destruction to a stage. Placed around calls that take microseconds at least:
+// reading the clock costs tens of nanoseconds.
+class stage_timer {
+public:
+  explicit stage_timer(stage s, std::size_t bytes = 0) : s(s), bytes(bytes), active(stats::enabled()) {
+    if (active) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  stage_timer(const stage_timer&) = delete;
+  stage_timer& operator=(const stage_timer&) = delete;
+
+  ~stage_timer() {
+    if (active) {
+      stats::record(s, std::chrono::steady_clock::now() - start, bytes);
+    }
+  }
+
+  // For stages whose size is known only at the end, like a read
+  void add_bytes(std::size_t count) {
+    bytes += count;
+  }
+
+private:
+  stage s;
+  std::size_t bytes;
+  bool active;
+  std::chrono::steady_clock::time_point start;
+};
+
+inline void count_io(std::size_t bytes_in, std::size_t bytes_out) {
+  if (stats::enabled()) {
+    stats::count_io(bytes_in, bytes_out);
+  }
+}
+
+inline void count_symbols(std::size_t symbols, std::size_t code_bits) {
+  if (stats::enabled()) {
+    stats::count_symbols(symbols, code_bits);
+  }
+}
+} // namespace huffman
+#endif // HUFFMAN_STATS_H
@@ -0,0 +1,52 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#include "thread_pool.h"
+
+namespace huffman {
+thread_pool::thread_pool(std::size_t threads) {
+  workers.reserve(threads);
+  for (std::size_t i = 0; i != threads; ++i) {
+    workers.emplace_back(&thread_pool::work, this);
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopped = true;
+  }
+  cv.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+std::future<void> thread_pool::submit(std::function<void()> task) {
+  std::packaged_task<void()> packaged(std::move(task));
+  std::future<void> result = packaged.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push(std::move(packaged));
+  }
+  cv.notify_one();
+  return result;
+}
+
+void thread_pool::work() {
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [this] { return stopped || !tasks.empty(); });
+      if (tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+    task();
+  }
+}
+} // namespace huffman
@@ -0,0 +1,39 @@
+//
+// Created by Tedes on 17.10.2026.
+//
+
+#ifndef HUFFMAN_THREAD_POOL_H
+#define HUFFMAN_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace huffman {
+// Fixed set of workers running submitted tasks in FIFO order. The destructor runs the remaining tasks and joins.
+class thread_pool {
+public:
+  explicit thread_pool(std::size_t threads);
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // Exceptions thrown by the task are rethrown by the returned future
+  std::future<void> submit(std::function<void()> task);
+
+private:
+  void work();
+
+  std::vector<std::thread> workers;
+  std::queue<std::packaged_task<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopped = false;
+};
+} // namespace huffman
+#endif // HUFFMAN_THREAD_POOL_H
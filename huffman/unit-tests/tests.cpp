@@ -2,17 +2,31 @@
 // Created by Tedes on 03.06.2023.
 //
 
+#include "../huffman_lib/binary_io/async_stream.h"
 #include "../huffman_lib/binary_io/binary_reader.h"
 #include "../huffman_lib/binary_io/binary_writer.h"
+#include "../huffman_lib/binary_io/mapped_file.h"
 #include "../huffman_lib/huffman.h"
+#include "../huffman_lib/huffman_block/block_codec.h"
+#include "../huffman_lib/huffman_context/context.h"
 #include "../huffman_lib/huffman_convert_tree/convert_tree.h"
+#include "../huffman_lib/huffman_freq/freq.h"
+#include "../huffman_lib/huffman_shared/shared_table.h"
+#include "../huffman_lib/utils/checksum.h"
+#include "../huffman_lib/utils/stats.h"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <map>
+#include <random>
 #include <set>
+#include <sstream>
+#include <utility>
 
 const std::string path = ROOT_DIRECTORY;
 const std::string source_dir = "dataset";
@@ -183,3 +197,929 @@ TEST(decode_converting, same_value_code_len) {
     ASSERT_THROW(huffman::convert_tree conv_tree(code_len), std::runtime_error);
   }
 }
+
+// Options with the given block size and threads, the other fields keep their defaults
+static huffman::encode_options block_options(std::size_t block_size, std::size_t threads = 1) {
+  huffman::encode_options options;
+  options.block_size = block_size;
+  options.threads = threads;
+  return options;
+}
+
+static huffman::decode_options thread_options(std::size_t threads) {
+  huffman::decode_options options;
+  options.threads = threads;
+  return options;
+}
+
+static std::string encode_string(const std::string& data, const huffman::encode_options& options = {}) {
+  std::stringstream in(data), out;
+  huffman::encode(in, out, options);
+  return out.str();
+}
+
+static std::string decode_string(const std::string& data, const huffman::decode_options& options = {}) {
+  std::stringstream in(data), out;
+  huffman::decode(in, out, options);
+  return out.str();
+}
+
+TEST(decode_converting, long_codes) {
+  // Fibonacci frequencies give the deepest possible tree, so codes go through the decoder sub-tables
+  std::string data;
+  for (std::size_t i = 0, a = 1, b = 1; i != 28; ++i, b = std::exchange(a, a + b)) {
+    data.append(a, static_cast<char>('a' + i));
+  }
+  std::mt19937 gen(1337);
+  std::shuffle(data.begin(), data.end(), gen);
+  ASSERT_EQ(decode_string(encode_string(data, block_options(0))), data);
+  ASSERT_EQ(decode_string(encode_string(data)), data);
+}
+
+TEST(decode_converting, truncated_input) {
+  std::string encoded = encode_string("abracadabra, abracadabra, abracadabra", block_options(0));
+  ASSERT_THROW(decode_string(encoded.substr(0, huffman::NUMBER_ATOM_CHARS)), std::runtime_error);
+  ASSERT_THROW(decode_string(encoded.substr(0, encoded.size() - 1)), std::runtime_error);
+}
+
+TEST(block_test, small_blocks) {
+  std::string data;
+  std::mt19937 gen(1337);
+  for (std::size_t i = 0; i != 10000; ++i) {
+    data.push_back(static_cast<char>('a' + gen() % (i % 26 + 1)));
+  }
+  for (std::size_t block_size : {1, 2, 7, 1000, 9999, 10000, 10001}) {
+    ASSERT_EQ(decode_string(encode_string(data, block_options(block_size))), data);
+  }
+  ASSERT_EQ(decode_string(encode_string("", block_options(1))), "");
+  std::string same(10000, 'a');
+  ASSERT_EQ(decode_string(encode_string(same)), same);
+}
+
+TEST(block_test, truncated_input) {
+  std::string encoded = encode_string("abracadabra, abracadabra, abracadabra", block_options(10));
+  for (std::size_t size = 0; size != encoded.size(); ++size) {
+    ASSERT_THROW(decode_string(encoded.substr(0, size)), std::runtime_error);
+  }
+}
+
+TEST(block_test, too_big_block) {
+  ASSERT_THROW(encode_string("abracadabra", block_options(huffman::MAX_BLOCK_SIZE + 1)), std::runtime_error);
+}
+
+TEST(block_test, parallel_same_output) {
+  std::string data;
+  std::mt19937 gen(1337);
+  for (std::size_t i = 0; i != 100000; ++i) {
+    data.push_back(static_cast<char>('a' + gen() % (i % 26 + 1)));
+  }
+  std::string encoded = encode_string(data, block_options(1000));
+  for (std::size_t threads : {2, 3, 8}) {
+    ASSERT_EQ(encode_string(data, block_options(1000, threads)), encoded);
+    ASSERT_EQ(decode_string(encoded, thread_options(threads)), data);
+  }
+  ASSERT_EQ(decode_string(encode_string("", block_options(1000, 4)), thread_options(4)), "");
+}
+
+TEST(block_test, parallel_broken_block) {
+  std::string encoded = encode_string(std::string(10000, 'a'), block_options(100, 4));
+  auto index = huffman::block_decoder::read_index(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size());
+  ASSERT_EQ(index.size(), 100);
+  encoded[index[50].encoded_offset] = 7;
+  ASSERT_THROW(decode_string(encoded, thread_options(4)), std::runtime_error);
+}
+
+TEST(block_test, fallback_types) {
+  auto type = [](const std::string& encoded) {
+    return static_cast<huffman::block_type>(encoded[huffman::BLOCK_MAGIC.size()]);
+  };
+  std::string random;
+  std::mt19937 gen(3);
+  for (std::size_t i = 0; i != 100000; ++i) {
+    random.push_back(static_cast<char>(gen()));
+  }
+  std::string encoded = encode_string(random);
+  ASSERT_EQ(type(encoded), huffman::block_type::stored);
+  ASSERT_LT(encoded.size(), random.size() + 64);
+  ASSERT_EQ(decode_string(encoded), random);
+
+  std::string same(1 << 20, 'a');
+  encoded = encode_string(same);
+  ASSERT_EQ(type(encoded), huffman::block_type::rle);
+  ASSERT_LT(encoded.size(), 64);
+  ASSERT_EQ(decode_string(encoded), same);
+
+  std::string runs;
+  for (std::size_t i = 0; runs.size() < 100000; ++i) {
+    runs.append(1 + gen() % 300, static_cast<char>(i % 3 == 0 ? gen() : 'z'));
+  }
+  encoded = encode_string(runs);
+  ASSERT_EQ(type(encoded), huffman::block_type::rle);
+  ASSERT_EQ(decode_string(encoded), runs);
+}
+
+TEST(block_test, sparse_runs) {
+  // Huffman codes take a bit for every 'a', the runs take a couple of bytes for every 'b'
+  std::string sparse(1 << 20, 'a');
+  std::mt19937 gen(7);
+  for (std::size_t i = 0; i != sparse.size() / 100; ++i) {
+    sparse[gen() % sparse.size()] = 'b';
+  }
+  std::string encoded = encode_string(sparse);
+  ASSERT_EQ(static_cast<huffman::block_type>(encoded[huffman::BLOCK_MAGIC.size()]), huffman::block_type::rle);
+  ASSERT_LT(encoded.size(), sparse.size() / 16);
+  ASSERT_EQ(decode_string(encoded), sparse);
+}
+
+TEST(block_test, broken_runs) {
+  std::string encoded = encode_string(std::string(1200, 'a') + std::string(1000, 'b'));
+  // type, raw size, checksum and payload size precede the runs: 'a', 1199 and 'b', 999 as varints
+  std::size_t runs = huffman::BLOCK_MAGIC.size() + 1 + 4 + 4 + 4;
+  ASSERT_EQ(encoded.substr(runs, 6), std::string("a\xAF\x09" "b\xE7\x07"));
+  for (std::size_t i : {1, 2, 4, 5}) {
+    std::string broken = encoded;
+    broken[runs + i] ^= 0x01;
+    ASSERT_THROW(decode_string(broken), std::runtime_error);
+  }
+  std::string broken = encoded;
+  broken[runs + 5] = '\x87';
+  ASSERT_THROW(decode_string(broken), std::runtime_error);
+}
+
+// Hands out the data once and can't be rewound, like a pipe
+class pipe_source : public std::streambuf {
+public:
+  explicit pipe_source(std::string data) : data(std::move(data)) {
+    setg(this->data.data(), this->data.data(), this->data.data() + this->data.size());
+  }
+
+private:
+  std::string data;
+};
+
+TEST(block_test, pipe_input) {
+  std::string data = "abracadabra, abracadabra, abracadabra";
+  huffman::encode_options options;
+  options.block_size = 0;
+  pipe_source single_table_source(data);
+  std::istream single_table_in(&single_table_source);
+  std::stringstream out;
+  ASSERT_THROW(huffman::encode(single_table_in, out, options), std::runtime_error);
+
+  options.block_size = 10;
+  pipe_source block_source(data);
+  std::istream block_in(&block_source);
+  std::stringstream encoded;
+  huffman::encode(block_in, encoded, options);
+  ASSERT_EQ(decode_string(encoded.str()), data);
+}
+
+static std::string encode_memory(const std::string& data, const huffman::encode_options& options = {}) {
+  std::stringstream out;
+  huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(data.data()), data.size(), out, options);
+  return out.str();
+}
+
+static std::string decode_memory(const std::string& data, const huffman::decode_options& options = {}) {
+  std::stringstream out;
+  huffman::decode(reinterpret_cast<const unsigned char*>(data.data()), data.size(), out, options);
+  return out.str();
+}
+
+TEST(memory_test, same_as_stream) {
+  std::string data;
+  std::mt19937 gen(1337);
+  for (std::size_t i = 0; i != 30000; ++i) {
+    data.push_back(static_cast<char>('a' + gen() % (i % 26 + 1)));
+  }
+  for (std::size_t block_size : {0, 7, 1000, 1 << 20}) {
+    std::string encoded = encode_string(data, block_options(block_size));
+    ASSERT_EQ(encode_memory(data, block_options(block_size)), encoded);
+    ASSERT_EQ(encode_memory(data, block_options(block_size, 3)), encoded);
+    ASSERT_EQ(decode_memory(encoded), data);
+    ASSERT_EQ(decode_memory(encoded, thread_options(3)), data);
+  }
+  ASSERT_EQ(decode_memory(encode_memory("", block_options(0))), "");
+  ASSERT_EQ(decode_memory(encode_memory("")), "");
+}
+
+TEST(memory_test, truncated_input) {
+  for (std::size_t block_size : {0, 10}) {
+    std::string encoded = encode_string("abracadabra, abracadabra, abracadabra", block_options(block_size));
+    ASSERT_THROW(decode_memory(""), std::runtime_error);
+    ASSERT_THROW(decode_memory(encoded.substr(0, encoded.size() / 2)), std::runtime_error);
+    ASSERT_THROW(decode_memory(encoded.substr(0, encoded.size() - 1)), std::runtime_error);
+  }
+}
+
+TEST(memory_test, mapped_file) {
+  std::string data = "abracadabra, abracadabra, abracadabra";
+  std::ofstream("tmp_mapped", std::ios::binary) << data;
+  {
+    huffman::mapped_file file("tmp_mapped");
+    ASSERT_EQ(std::string(file.data(), file.data() + file.size()), data);
+  }
+  std::ofstream("tmp_mapped", std::ios::binary);
+  {
+    huffman::mapped_file file("tmp_mapped");
+    ASSERT_EQ(file.size(), 0);
+  }
+  std::filesystem::remove("tmp_mapped");
+  ASSERT_THROW(huffman::mapped_file file("tmp_mapped"), std::runtime_error);
+}
+
+TEST(freq_test, same_as_plain_count) {
+  std::mt19937 gen(1337);
+  for (std::size_t size : {0, 1, 7, 4095, 4096, 4097, 100003}) {
+    std::vector<huffman::atom_char_t> data(size);
+    for (std::size_t i = 0; i != size; ++i) {
+      data[i] = static_cast<huffman::atom_char_t>(i % 3 == 0 ? 'a' : gen() % (i % 256 + 1));
+    }
+    std::vector<huffman::int_freq_t> expected(huffman::NUMBER_ATOM_CHARS, 1);
+    for (huffman::atom_char_t c : data) {
+      expected[c]++;
+    }
+    std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 1);
+    huffman::count_freq(data.data(), data.size(), freq);
+    ASSERT_EQ(freq, expected);
+  }
+}
+
+TEST(encode_converting, full_last_out_char) {
+  for (std::size_t size : {64, 128, 4096}) {
+    std::string data;
+    for (std::size_t i = 0; i != size; ++i) {
+      data.push_back(i % 3 == 0 ? 'a' : 'b');
+    }
+    std::string encoded = encode_string(data, block_options(0));
+    ASSERT_EQ(encoded.size(), huffman::NUMBER_ATOM_CHARS + size / huffman::ATOM_CHAR_SIZE + 1);
+    ASSERT_EQ(static_cast<unsigned char>(encoded.back()), huffman::OUT_CHAR_SIZE);
+    ASSERT_EQ(decode_string(encoded), data);
+  }
+}
+
+TEST(encode_converting, length_limited_codes) {
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+  freq[0] = freq[1] = 1;
+  for (std::size_t i = 2; i != 60; ++i) {
+    freq[i] = freq[i - 1] + freq[i - 2];
+  }
+  huffman::encode_table table = huffman::convert_tree::get_encode_table(freq);
+  std::vector<huffman::atom_char_t> code_len(huffman::NUMBER_ATOM_CHARS);
+  huffman::out_char_t kraft_sum = 0;
+  for (std::size_t el = 0; el != huffman::NUMBER_ATOM_CHARS; ++el) {
+    code_len[el] = table[el].len;
+    ASSERT_LE(table[el].len, huffman::MAX_ENCODE_CODE_LEN);
+    ASSERT_EQ(table[el].len != 0, freq[el] != 0);
+    if (table[el].len != 0) {
+      kraft_sum += huffman::out_char_t(1) << (huffman::MAX_ENCODE_CODE_LEN - table[el].len);
+    }
+  }
+  ASSERT_EQ(kraft_sum, huffman::out_char_t(1) << huffman::MAX_ENCODE_CODE_LEN);
+  ASSERT_NO_THROW(huffman::convert_tree conv_tree(code_len));
+}
+
+TEST(encode_converting, optimal_code_len) {
+  std::mt19937 gen(7);
+  for (std::size_t symbols : {2, 3, 17, 200, 256}) {
+    std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+    std::vector<huffman::int_freq_t> weights;
+    for (std::size_t i = 0; i != symbols; ++i) {
+      std::size_t el = i * huffman::NUMBER_ATOM_CHARS / symbols;
+      freq[el] = 1 + gen() % (i % 3 == 0 ? 10 : 100000);
+      weights.push_back(freq[el]);
+    }
+    // the cost of a Huffman code is the sum of the weights of its internal nodes
+    std::sort(weights.begin(), weights.end(), std::greater<>());
+    huffman::int_freq_t expected_bits = 0;
+    while (weights.size() > 1) {
+      huffman::int_freq_t merged = weights.back();
+      weights.pop_back();
+      merged += weights.back();
+      weights.pop_back();
+      expected_bits += merged;
+      weights.insert(std::upper_bound(weights.begin(), weights.end(), merged, std::greater<>()), merged);
+    }
+    huffman::encode_table table = huffman::convert_tree::get_encode_table(freq);
+    huffman::int_freq_t bits = 0;
+    for (std::size_t el = 0; el != huffman::NUMBER_ATOM_CHARS; ++el) {
+      ASSERT_EQ(table[el].len != 0, freq[el] != 0);
+      bits += freq[el] * table[el].len;
+    }
+    ASSERT_EQ(bits, expected_bits);
+  }
+}
+
+TEST(encode_converting, single_symbol_freq) {
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+  freq['a'] = 10;
+  ASSERT_THROW(huffman::convert_tree::get_encode_table(freq), std::runtime_error);
+}
+
+static std::vector<std::string> make_messages(std::size_t count) {
+  std::vector<std::string> messages;
+  std::mt19937 gen(1337);
+  for (std::size_t i = 0; i != count; ++i) {
+    std::string message;
+    for (std::size_t j = gen() % 2000; j != 0; --j) {
+      message.push_back(static_cast<char>('a' + gen() % (j % 26 + 1)));
+    }
+    messages.push_back(message);
+  }
+  return messages;
+}
+
+TEST(message_context_test, same_as_stream) {
+  huffman::encoder encoder;
+  huffman::decoder decoder;
+  std::vector<unsigned char> encoded;
+  std::vector<huffman::atom_char_t> decoded;
+  for (const std::string& message : make_messages(100)) {
+    encoder.encode(reinterpret_cast<const huffman::atom_char_t*>(message.data()), message.size(), encoded);
+    // messages hold the same blocks as a stream, but end without the index
+    std::string stream = encode_string(message);
+    ASSERT_EQ(std::string(encoded.begin(), encoded.end() - 1), stream.substr(0, encoded.size() - 1));
+    ASSERT_EQ(encoded.back(), static_cast<unsigned char>(huffman::block_type::end));
+    decoder.decode(encoded.data(), encoded.size(), decoded);
+    ASSERT_EQ(std::string(decoded.begin(), decoded.end()), message);
+  }
+}
+
+TEST(message_context_test, shared_table) {
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+  for (char c = 'a'; c <= 'z'; ++c) {
+    freq[static_cast<unsigned char>(c)] = 'z' - c + 1;
+  }
+  huffman::encode_options options;
+  huffman::decode_options decode_options;
+  options.table = decode_options.table = std::make_shared<const huffman::shared_table>(freq);
+  huffman::encoder encoder(options);
+  huffman::decoder decoder(decode_options);
+  huffman::encoder own_table_encoder;
+  std::vector<unsigned char> encoded, own_table_encoded;
+  std::vector<huffman::atom_char_t> decoded;
+  for (std::string message : make_messages(100)) {
+    message += '\xff';
+    encoder.encode(reinterpret_cast<const huffman::atom_char_t*>(message.data()), message.size(), encoded);
+    decoder.decode(encoded.data(), encoded.size(), decoded);
+    ASSERT_EQ(std::string(decoded.begin(), decoded.end()), message);
+    own_table_encoder.encode(reinterpret_cast<const huffman::atom_char_t*>(message.data()), message.size(),
+                             own_table_encoded);
+    // the shortest messages are stored either way
+    if (message.size() < 32) {
+      ASSERT_LE(encoded.size(), own_table_encoded.size());
+    } else if (message.size() < 100) {
+      ASSERT_LT(encoded.size(), own_table_encoded.size());
+    }
+  }
+  huffman::decoder no_table_decoder;
+  ASSERT_THROW(no_table_decoder.decode(encoded.data(), encoded.size(), decoded), std::runtime_error);
+  ASSERT_THROW(decode_string(std::string(encoded.begin(), encoded.end())), std::runtime_error);
+}
+
+TEST(message_context_test, broken_message) {
+  huffman::encoder encoder;
+  huffman::decoder decoder;
+  std::string message = "abracadabra, abracadabra, abracadabra";
+  std::vector<unsigned char> encoded;
+  std::vector<huffman::atom_char_t> decoded;
+  encoder.encode(reinterpret_cast<const huffman::atom_char_t*>(message.data()), message.size(), encoded);
+  for (std::size_t size = 0; size != encoded.size(); ++size) {
+    ASSERT_THROW(decoder.decode(encoded.data(), size, decoded), std::runtime_error);
+  }
+  decoder.decode(encoded.data(), encoded.size(), decoded);
+  ASSERT_EQ(std::string(decoded.begin(), decoded.end()), message);
+}
+
+static std::shared_ptr<const huffman::shared_table> train_table(const std::vector<std::string>& samples) {
+  std::vector<huffman::int_freq_t> freq(huffman::NUMBER_ATOM_CHARS, 0);
+  for (const std::string& sample : samples) {
+    huffman::count_freq(reinterpret_cast<const huffman::atom_char_t*>(sample.data()), sample.size(), freq);
+  }
+  return std::make_shared<const huffman::shared_table>(freq);
+}
+
+TEST(shared_table_test, save_load) {
+  auto table = train_table(make_messages(50));
+  std::stringstream file;
+  table->save(file);
+  huffman::shared_table loaded = huffman::shared_table::load(file);
+  ASSERT_EQ(loaded.id(), table->id());
+  ASSERT_EQ(loaded.code_len(), table->code_len());
+  ASSERT_NE(train_table({"abc"})->id(), table->id());
+
+  std::string broken = file.str();
+  for (std::size_t size = 0; size != broken.size(); ++size) {
+    std::istringstream in(broken.substr(0, size));
+    ASSERT_THROW(huffman::shared_table::load(in), std::runtime_error);
+  }
+  broken.back()++;
+  std::istringstream in(broken);
+  ASSERT_THROW(huffman::shared_table::load(in), std::runtime_error);
+}
+
+TEST(shared_table_test, stream) {
+  huffman::encode_options options;
+  options.block_size = 1000;
+  options.table = train_table(make_messages(50));
+  huffman::decode_options decode_options;
+  decode_options.table = options.table;
+  for (const std::string& message : make_messages(20)) {
+    std::string encoded = encode_string(message, options);
+    ASSERT_EQ(decode_string(encoded, decode_options), message);
+    ASSERT_EQ(decode_memory(encoded, decode_options), message);
+  }
+  options.threads = decode_options.threads = 3;
+  std::string message = make_messages(50).back() + std::string(5000, 'z');
+  ASSERT_EQ(decode_string(encode_string(message, options), decode_options), message);
+  options.block_size = 0;
+  ASSERT_THROW(encode_string(message, options), std::runtime_error);
+}
+
+TEST(shared_table_test, another_table) {
+  huffman::encode_options options;
+  options.table = train_table({"abracadabra"});
+  huffman::decode_options decode_options;
+  decode_options.table = train_table({"abracadabra, abracadabra"});
+  // long enough not to be stored
+  std::string message;
+  for (std::size_t i = 0; i != 10; ++i) {
+    message += "abracadabra";
+  }
+  std::string encoded = encode_string(message, options);
+  ASSERT_THROW(decode_string(encoded, decode_options), std::runtime_error);
+  ASSERT_THROW(decode_string(encoded), std::runtime_error);
+  decode_options.table = options.table;
+  ASSERT_EQ(decode_string(encoded, decode_options), message);
+}
+
+TEST(shared_table_test, stored_fallback) {
+  std::string random;
+  std::mt19937 gen(3);
+  for (std::size_t i = 0; i != 10000; ++i) {
+    random.push_back(static_cast<char>(gen()));
+  }
+  huffman::encode_options options;
+  huffman::decode_options decode_options;
+  options.table = decode_options.table = train_table({"abracadabra"});
+  std::string encoded = encode_string(random, options);
+  ASSERT_EQ(static_cast<huffman::block_type>(encoded[huffman::BLOCK_MAGIC.size()]), huffman::block_type::stored);
+  ASSERT_EQ(decode_string(encoded, decode_options), random);
+  ASSERT_EQ(decode_string(encoded), random);
+}
+
+TEST(interleaved_test, block_sizes) {
+  std::string data;
+  std::mt19937 gen(7);
+  for (std::size_t i = 0; i != 70000; ++i) {
+    // rare bytes get long codes, which are decoded from the sub-tables
+    data.push_back(static_cast<char>(gen() % 64 == 0 ? gen() : 'a' + gen() % 3));
+  }
+  for (std::size_t block_size : {16383, 16384, 16385, 16387, 50001, 70000}) {
+    std::string encoded = encode_string(data, block_options(block_size));
+    ASSERT_EQ(encoded[4] & huffman::INTERLEAVED_FLAG, block_size >= 16384 ? huffman::INTERLEAVED_FLAG : 0);
+    ASSERT_EQ(decode_string(encoded), data);
+    ASSERT_EQ(decode_memory(encoded), data);
+  }
+  std::string same(100000, 'a');
+  ASSERT_EQ(decode_string(encode_string(same)), same);
+
+  huffman::encode_options options;
+  huffman::decode_options decode_options;
+  options.table = decode_options.table = train_table({"abc"});
+  ASSERT_EQ(decode_string(encode_string(data, options), decode_options), data);
+}
+
+TEST(interleaved_test, broken_jump_table) {
+  std::string data(20000, 'a');
+  for (std::size_t i = 0; i < data.size(); i += 3) {
+    data[i] = 'b';
+  }
+  std::string encoded = encode_string(data);
+  // magic, type, raw size, checksum, bitmap, two code lengths and the payload size precede the jump table
+  std::size_t jump_table = 4 + 1 + 4 + 4 + 32 + 2 + 4;
+  for (std::size_t i = 0; i != 12; ++i) {
+    std::string broken = encoded;
+    broken[jump_table + i] ^= 0x10;
+    ASSERT_THROW(decode_string(broken), std::runtime_error);
+  }
+}
+
+TEST(checksum_test, xxhash64) {
+  auto hash = [](const std::string& data) {
+    return huffman::xxhash64(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+  };
+  ASSERT_EQ(hash(""), 0xef46db3751d8e999);
+  ASSERT_EQ(hash("a"), 0xd24ec4f1a98c6e5b);
+  ASSERT_EQ(hash("abc"), 0x44bc2cf5ad770999);
+  ASSERT_EQ(hash("Nobody inspects the spammish repetition"), 0xfbcea83c8a378bf1);
+}
+
+TEST(checksum_test, broken_payload) {
+  std::string data;
+  std::mt19937 gen(11);
+  for (std::size_t i = 0; i != 3000; ++i) {
+    data.push_back(static_cast<char>('a' + gen() % 4));
+  }
+  std::string encoded = encode_string(data, block_options(1000));
+  auto index = huffman::block_decoder::read_index(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size());
+  ASSERT_EQ(index.size(), 3);
+  // every byte of the first block is a valid code, only the checksum can tell that one was flipped
+  std::size_t payload_end = index[1].encoded_offset;
+  for (std::size_t pos = payload_end - 100; pos < payload_end; pos += 7) {
+    std::string broken = encoded;
+    broken[pos] ^= 0x21;
+    ASSERT_THROW(decode_string(broken), std::runtime_error);
+    ASSERT_THROW(decode_memory(broken), std::runtime_error);
+  }
+}
+
+static std::string decode_range_string(const std::string& data, std::size_t offset, std::size_t length,
+                                       const huffman::decode_options& options = {}) {
+  std::stringstream in(data);
+  std::stringstream out;
+  huffman::decode_range(in, out, offset, length, options);
+  return out.str();
+}
+
+static std::string decode_range_memory(const std::string& data, std::size_t offset, std::size_t length,
+                                       const huffman::decode_options& options = {}) {
+  std::stringstream out;
+  huffman::decode_range(reinterpret_cast<const unsigned char*>(data.data()), data.size(), out, offset, length, options);
+  return out.str();
+}
+
+TEST(range_test, index) {
+  std::string data(2500, 'a');
+  std::string encoded = encode_string(data, block_options(1000));
+  auto index = huffman::block_decoder::read_index(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size());
+  ASSERT_EQ(index.size(), 3);
+  for (std::size_t i = 0; i != index.size(); ++i) {
+    ASSERT_EQ(index[i].raw_offset, i * 1000);
+    ASSERT_EQ(encoded[index[i].encoded_offset], encoded[huffman::BLOCK_MAGIC.size()]);
+  }
+  ASSERT_EQ(index[0].encoded_offset, huffman::BLOCK_MAGIC.size());
+  ASSERT_TRUE(huffman::block_decoder::read_index(reinterpret_cast<const unsigned char*>(encoded.data()), 10).empty());
+}
+
+TEST(range_test, same_as_substr) {
+  std::string data;
+  std::mt19937 gen(5);
+  for (std::size_t i = 0; i != 5000; ++i) {
+    data.push_back(static_cast<char>('a' + gen() % (i % 26 + 1)));
+  }
+  std::string encoded = encode_string(data, block_options(1000));
+  for (std::size_t offset : {0, 1, 999, 1000, 1001, 2500, 4999, 5000, 6000}) {
+    for (std::size_t length : {0, 1, 999, 1000, 1001, 3000, 10000}) {
+      ASSERT_EQ(decode_range_string(encoded, offset, length), data.substr(std::min(offset, data.size()), length));
+      ASSERT_EQ(decode_range_memory(encoded, offset, length), data.substr(std::min(offset, data.size()), length));
+    }
+  }
+  ASSERT_EQ(decode_range_memory(encoded, 4000, std::numeric_limits<std::size_t>::max()), data.substr(4000));
+  ASSERT_THROW(decode_range_memory(encode_string(data, block_options(0)), 0, 10), std::runtime_error);
+  ASSERT_THROW(decode_range_string(encode_string(data, block_options(0)), 0, 10), std::runtime_error);
+}
+
+TEST(range_test, without_index) {
+  huffman::encoder encoder;
+  std::vector<unsigned char> message;
+  encoder.encode(reinterpret_cast<const huffman::atom_char_t*>("abracadabra"), 11, message);
+  std::string encoded(message.begin(), message.end());
+  ASSERT_EQ(decode_range_memory(encoded, 4, 3), "cad");
+  ASSERT_EQ(decode_range_string(encoded, 4, 3), "cad");
+}
+
+TEST(range_test, broken_index) {
+  std::string encoded = encode_string(std::string(5000, 'a'), block_options(1000));
+  // entries of 2 u64 are followed by their count and the magic
+  std::size_t second_entry = encoded.size() - 8 - 4 * 16;
+  ASSERT_EQ(decode_range_memory(encoded, 1500, 10), std::string(10, 'a'));
+  for (std::size_t byte : {6, 14}) {
+    std::string broken = encoded;
+    broken[second_entry + byte] ^= 1;
+    ASSERT_THROW(decode_range_memory(broken, 1500, 10), std::runtime_error);
+  }
+  encoded[encoded.size() - 6] ^= 1;
+  ASSERT_THROW(decode_range_memory(encoded, 1500, 10), std::runtime_error);
+}
+
+static std::string make_text(std::size_t size) {
+  const std::vector<std::string> words = {"the", "winter", "night", "snow", "was", "sweeping", "over", "all",
+                                          "land", "candle", "burned", "on", "table", "and", "to", "ceiling"};
+  std::mt19937 gen(17);
+  std::string text;
+  while (text.size() < size) {
+    text += words[gen() % words.size()];
+    text += gen() % 10 == 0 ? ".\n" : " ";
+  }
+  text.resize(size);
+  return text;
+}
+
+TEST(context_model_test, round_trip) {
+  huffman::encode_options options;
+  options.context_model = true;
+  for (std::size_t size : {1, 100, 5000, 16383, 16384, 100000}) {
+    std::string text = make_text(size);
+    std::string encoded = encode_string(text, options);
+    if (size >= 5000) {
+      ASSERT_EQ(static_cast<unsigned char>(encoded[huffman::BLOCK_MAGIC.size()]) & ~huffman::INTERLEAVED_FLAG,
+                static_cast<unsigned char>(huffman::block_type::context));
+      ASSERT_LT(encoded.size(), encode_string(text).size() * (size >= 16384 ? 3 : 4) / 4);
+    }
+    ASSERT_EQ(decode_string(encoded), text);
+    ASSERT_EQ(decode_memory(encoded), text);
+  }
+  std::string text = make_text(300000);
+  options.block_size = 20000;
+  options.threads = 3;
+  ASSERT_EQ(decode_string(encode_string(text, options), thread_options(3)), text);
+  // bytes without an order-1 pattern keep their order-0 codes
+  std::string random;
+  std::mt19937 gen(5);
+  for (std::size_t i = 0; i != 50000; ++i) {
+    random.push_back(static_cast<char>('a' + gen() % 8));
+  }
+  ASSERT_EQ(encode_string(random, options), encode_string(random, block_options(20000, 3)));
+}
+
+TEST(context_model_test, not_larger_than_order0) {
+  // every byte is known from the one before it, but its code still takes a bit
+  huffman::encode_options options;
+  options.context_model = true;
+  for (std::size_t size : {2000, 1 << 20}) {
+    std::string text;
+    while (text.size() != size) {
+      text += "ab";
+    }
+    std::string encoded = encode_string(text, options);
+    ASSERT_LE(encoded.size(), encode_string(text).size());
+    ASSERT_EQ(decode_string(encoded), text);
+  }
+}
+
+TEST(context_model_test, cluster_contexts) {
+  std::vector<huffman::int_freq_t> pair_freq(huffman::NUMBER_ATOM_CHARS * huffman::NUMBER_ATOM_CHARS);
+  // bytes after a digit are digits, bytes after a letter are letters
+  for (std::size_t context = '0'; context <= '9'; ++context) {
+    for (std::size_t el = '0'; el <= '9'; ++el) {
+      pair_freq[context * huffman::NUMBER_ATOM_CHARS + el] = 10 + el;
+    }
+  }
+  for (std::size_t context = 'a'; context <= 'z'; ++context) {
+    for (std::size_t el = 'a'; el <= 'z'; ++el) {
+      pair_freq[context * huffman::NUMBER_ATOM_CHARS + el] = 10 + el;
+    }
+  }
+  auto groups = huffman::cluster_contexts(pair_freq, 16);
+  for (char c = '0'; c <= '9'; ++c) {
+    ASSERT_EQ(groups[static_cast<unsigned char>(c)], groups['0']);
+  }
+  for (char c = 'a'; c <= 'z'; ++c) {
+    ASSERT_EQ(groups[static_cast<unsigned char>(c)], groups['a']);
+  }
+  ASSERT_NE(groups['0'], groups['a']);
+  groups = huffman::cluster_contexts(pair_freq, 1);
+  ASSERT_EQ(*std::max_element(groups.begin(), groups.end()), 0);
+}
+
+TEST(context_model_test, broken_group_map) {
+  huffman::encode_options options;
+  options.context_model = true;
+  std::string encoded = encode_string(make_text(10000), options);
+  // type, raw size and checksum precede the number of groups and the map
+  std::size_t groups = huffman::BLOCK_MAGIC.size() + 1 + 4 + 4;
+  ASSERT_GT(encoded[groups], 1);
+  std::string broken = encoded;
+  broken[groups] = 0;
+  ASSERT_THROW(decode_string(broken), std::runtime_error);
+  broken = encoded;
+  broken[groups] = huffman::MAX_CONTEXT_GROUPS + 1;
+  ASSERT_THROW(decode_string(broken), std::runtime_error);
+  broken = encoded;
+  broken[groups + 1 + 'e' / 2] |= 0x0F;
+  ASSERT_THROW(decode_string(broken), std::runtime_error);
+  ASSERT_THROW(decode_memory(broken), std::runtime_error);
+}
+
+// Accepts `limit` bytes, then fails like a full disk
+class limited_sink : public std::streambuf {
+public:
+  explicit limited_sink(std::size_t limit) : limit(limit) {}
+
+  std::string data;
+
+protected:
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    std::size_t size = std::min<std::size_t>(n, limit - data.size());
+    data.append(s, size);
+    return static_cast<std::streamsize>(size);
+  }
+
+  int_type overflow(int_type c) override {
+    return xsputn(reinterpret_cast<const char*>(&c), 1) == 1 ? traits_type::not_eof(c) : traits_type::eof();
+  }
+
+private:
+  std::size_t limit;
+};
+
+TEST(async_stream_test, round_trip) {
+  std::string text = make_text(100000);
+  for (std::size_t block_size : {std::size_t(0), std::size_t(1000), huffman::BLOCK_SIZE}) {
+    std::stringstream in(text);
+    std::stringstream encoded;
+    {
+      // small buffers, so the coder waits for both threads
+      huffman::async_istreambuf async_in(in.rdbuf(), 2, 7);
+      huffman::async_ostreambuf async_out(encoded.rdbuf(), 3, 5);
+      std::istream piped_in(&async_in);
+      std::ostream piped_out(&async_out);
+      huffman::encode(piped_in, piped_out, block_options(block_size));
+      piped_out.flush();
+      ASSERT_TRUE(piped_out.good());
+    }
+    ASSERT_EQ(encoded.str(), encode_string(text, block_options(block_size)));
+    std::stringstream decoded;
+    {
+      huffman::async_istreambuf async_in(encoded.rdbuf(), 3, 11);
+      huffman::async_ostreambuf async_out(decoded.rdbuf(), 2, 13);
+      std::istream piped_in(&async_in);
+      std::ostream piped_out(&async_out);
+      huffman::decode(piped_in, piped_out);
+    }
+    ASSERT_EQ(decoded.str(), text);
+  }
+}
+
+TEST(async_stream_test, seek) {
+  std::stringstream in("0123456789abcdef");
+  huffman::async_istreambuf async_in(in.rdbuf(), 2, 3);
+  std::istream piped_in(&async_in);
+  std::string head(5, '\0');
+  piped_in.read(head.data(), head.size());
+  ASSERT_EQ(head, "01234");
+  ASSERT_EQ(piped_in.tellg(), 5);
+  piped_in.seekg(-2, std::ios::cur);
+  ASSERT_EQ(piped_in.get(), '3');
+  piped_in.seekg(10);
+  std::string tail((std::istreambuf_iterator<char>(piped_in)), std::istreambuf_iterator<char>());
+  ASSERT_EQ(tail, "abcdef");
+}
+
+TEST(async_stream_test, writing_error) {
+  std::string text = make_text(10000);
+  limited_sink sink(100);
+  huffman::async_ostreambuf async_out(&sink, 2, 16);
+  std::ostream piped_out(&async_out);
+  ASSERT_THROW(huffman::encode(reinterpret_cast<const huffman::atom_char_t*>(text.data()), text.size(), piped_out),
+               std::runtime_error);
+  ASSERT_EQ(sink.data.size(), 100);
+}
+
+TEST(stats_test, counters) {
+  if (!huffman::STATS_ENABLED) {
+    GTEST_SKIP();
+  }
+  std::string text = make_text(50000);
+  huffman::stats::enable(true);
+  huffman::stats::reset();
+  std::string encoded = encode_string(text, block_options(10000));
+  huffman::stats_snapshot snapshot = huffman::stats::snapshot();
+  ASSERT_EQ(snapshot.bytes_in, text.size());
+  ASSERT_EQ(snapshot.bytes_out, encoded.size());
+  ASSERT_EQ(snapshot.symbols, text.size());
+  ASSERT_EQ(snapshot.stages[static_cast<std::size_t>(huffman::stage::freq)].bytes, text.size());
+  ASSERT_EQ(snapshot.stages[static_cast<std::size_t>(huffman::stage::tree)].calls, 5);
+  ASSERT_EQ(snapshot.stages[static_cast<std::size_t>(huffman::stage::write)].bytes, encoded.size());
+  ASSERT_GT(snapshot.stages[static_cast<std::size_t>(huffman::stage::read)].calls, 0);
+  std::size_t encode_bits = snapshot.code_bits;
+  ASSERT_LT(encode_bits, 8 * text.size());
+
+  huffman::stats::reset();
+  ASSERT_EQ(decode_string(encoded), text);
+  snapshot = huffman::stats::snapshot();
+  ASSERT_EQ(snapshot.bytes_in, encoded.size());
+  ASSERT_EQ(snapshot.bytes_out, text.size());
+  ASSERT_EQ(snapshot.symbols, text.size());
+  ASSERT_EQ(snapshot.code_bits, encode_bits);
+  ASSERT_EQ(snapshot.stages[static_cast<std::size_t>(huffman::stage::decode)].bytes, text.size());
+  ASSERT_EQ(snapshot.stages[static_cast<std::size_t>(huffman::stage::checksum)].calls, 5);
+
+  huffman::stats::enable(false);
+  huffman::stats::reset();
+  ASSERT_EQ(decode_string(encoded), text);
+  ASSERT_EQ(huffman::stats::snapshot().bytes_in, 0);
+}
+
+TEST(stats_test, formats) {
+  huffman::stats_snapshot snapshot;
+  snapshot.stages[static_cast<std::size_t>(huffman::stage::encode)] = {2000000, 1000000, 4};
+  snapshot.bytes_in = 1000000;
+  snapshot.bytes_out = 500000;
+  snapshot.symbols = 1000000;
+  snapshot.code_bits = 4000000;
+  std::ostringstream text;
+  huffman::stats::write(text, snapshot);
+  ASSERT_NE(text.str().find("encode           2.000         1000000         4     500.000"), std::string::npos);
+  ASSERT_NE(text.str().find("average code length: 4.000 bits"), std::string::npos);
+  std::ostringstream json;
+  huffman::stats::write(json, snapshot, true);
+  ASSERT_NE(json.str().find("\"encode\":{\"ms\":2.000,\"bytes\":1000000,\"calls\":4,\"mb_per_s\":500.000}"),
+            std::string::npos);
+  ASSERT_NE(json.str().find("\"bytes_out\":500000,\"symbols\":1000000,\"average_code_len\":4.000"), std::string::npos);
+}
+
+TEST(sync_test, same_as_sequential) {
+  std::mt19937 gen(2026);
+  std::geometric_distribution<int> skewed(0.1);
+  std::vector<std::function<char()>> sources = {
+      [&gen, &skewed] { return static_cast<char>(skewed(gen)); },
+      // codes of 8 bits, chunks start on code boundaries
+      [&gen] { return static_cast<char>(gen()); },
+      // codes of 7 and 8 bits
+      [&gen] { return static_cast<char>(gen() % 200); },
+      [&gen] { return static_cast<char>("ab"[gen() % 7 == 0]); },
+  };
+  for (auto& source : sources) {
+    std::string data(3 * huffman::SYNC_CHUNK_SIZE + 12345, '\0');
+    std::generate(data.begin(), data.end(), source);
+    std::string encoded = encode_memory(data, block_options(0));
+    for (std::size_t threads : {2, 3, 8}) {
+      ASSERT_EQ(decode_memory(encoded, thread_options(threads)), data);
+    }
+  }
+}
+
+TEST(sync_test, broken_input) {
+  std::mt19937 gen(7);
+  std::string data(4 * huffman::SYNC_CHUNK_SIZE, '\0');
+  std::generate(data.begin(), data.end(), [&gen] { return static_cast<char>(gen() % 100); });
+  std::string encoded = encode_memory(data, block_options(0));
+  ASSERT_THROW(decode_memory(encoded.substr(0, encoded.size() - 8), thread_options(4)), std::runtime_error);
+  // corrupted payloads decode to garbage, which has to be the same garbage as decoded by one thread
+  for (std::size_t pos : {huffman::NUMBER_ATOM_CHARS + 1, huffman::NUMBER_ATOM_CHARS + huffman::SYNC_CHUNK_SIZE - 1,
+                          encoded.size() / 2, encoded.size() - 1}) {
+    std::string broken = encoded;
+    broken[pos] = static_cast<char>(pos != encoded.size() - 1 ? ~broken[pos] : 1);
+    std::string sequential;
+    try {
+      sequential = decode_memory(broken);
+    } catch (std::runtime_error&) {
+      ASSERT_THROW(decode_memory(broken, thread_options(4)), std::runtime_error);
+      continue;
+    }
+    ASSERT_EQ(decode_memory(broken, thread_options(4)), sequential);
+  }
+}
+
+static std::string decode_into(const std::string& encoded, std::size_t capacity,
+                               const huffman::decode_options& options = {}) {
+  std::string out(capacity, '\0');
+  std::size_t size = huffman::decode_into(reinterpret_cast<const unsigned char*>(encoded.data()), encoded.size(),
+                                          reinterpret_cast<huffman::atom_char_t*>(out.data()), capacity, options);
+  out.resize(size);
+  return out;
+}
+
+TEST(decode_into_test, same_as_decode) {
+  std::string data;
+  std::mt19937 gen(18);
+  for (std::size_t i = 0; i != 100000; ++i) {
+    data.push_back(static_cast<char>(i % 5000 < 1000 ? 'x' : 'a' + gen() % (i % 26 + 1)));
+  }
+  for (std::size_t block_size : {0, 777, 1 << 20}) {
+    for (bool context_model : {false, true}) {
+      huffman::encode_options options = block_options(block_size);
+      options.context_model = context_model;
+      std::string encoded = encode_memory(data, options);
+      auto encoded_data = reinterpret_cast<const unsigned char*>(encoded.data());
+      if (block_size != 0) {
+        ASSERT_EQ(huffman::decoded_size(encoded_data, encoded.size()), data.size());
+      } else {
+        ASSERT_THROW(huffman::decoded_size(encoded_data, encoded.size()), std::runtime_error);
+      }
+      for (std::size_t threads : {1, 3}) {
+        ASSERT_EQ(decode_into(encoded, data.size(), thread_options(threads)), data);
+        ASSERT_EQ(decode_into(encoded, data.size() + 10, thread_options(threads)), data);
+        ASSERT_THROW(decode_into(encoded, data.size() - 1, thread_options(threads)), std::runtime_error);
+      }
+    }
+  }
+  ASSERT_EQ(decode_into(encode_memory(""), 0), "");
+  ASSERT_EQ(decode_into(encode_memory("", block_options(0)), 0), "");
+}
+
+TEST(decode_into_test, broken_block) {
+  std::string data(50000, 'a');
+  std::mt19937 gen(3);
+  std::generate(data.begin(), data.end(), [&gen] { return static_cast<char>('a' + gen() % 10); });
+  std::string encoded = encode_memory(data, block_options(1000));
+  for (std::size_t threads : {1, 4}) {
+    std::string broken = encoded;
+    broken[broken.size() / 2] ^= 0x10;
+    ASSERT_THROW(decode_into(broken, data.size(), thread_options(threads)), std::runtime_error);
+    ASSERT_THROW(decode_into(encoded.substr(0, encoded.size() / 2), data.size(), thread_options(threads)),
+                 std::runtime_error);
+  }
+}